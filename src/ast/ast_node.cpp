@@ -1,239 +1,464 @@
 #include "ast_node.hpp"
+#include "traversal.hpp"
 
 namespace ccc {
-std::string TranslationUnit::accept(Visitor<std::string> *v) {
-  return v->visitTranslationUnit(this);
+std::string ASTNode::accept(Visitor<std::string> *v) {
+  switch (kind) {
+  case NodeKind::TRANSLATION_UNIT:
+    return v->visitTranslationUnit(static_cast<TranslationUnit *>(this));
+  case NodeKind::FUNCTION_DEFINITION:
+    return v->visitFunctionDefinition(static_cast<FunctionDefinition *>(this));
+  case NodeKind::FUNCTION_DECLARATION:
+    return v->visitFunctionDeclaration(
+        static_cast<FunctionDeclaration *>(this));
+  case NodeKind::DATA_DECLARATION:
+    return v->visitDataDeclaration(static_cast<DataDeclaration *>(this));
+  case NodeKind::STRUCT_DECLARATION:
+    return v->visitStructDeclaration(static_cast<StructDeclaration *>(this));
+  case NodeKind::PARAM_DECLARATION:
+    return v->visitParamDeclaration(static_cast<ParamDeclaration *>(this));
+  case NodeKind::SCALAR_TYPE:
+    return v->visitScalarType(static_cast<ScalarType *>(this));
+  case NodeKind::STRUCT_TYPE:
+    return v->visitStructType(static_cast<StructType *>(this));
+  case NodeKind::ABSTRACT_TYPE:
+    return v->visitAbstractType(static_cast<AbstractType *>(this));
+  case NodeKind::DIRECT_DECLARATOR:
+    return v->visitDirectDeclarator(static_cast<DirectDeclarator *>(this));
+  case NodeKind::ABSTRACT_DECLARATOR:
+    return v->visitAbstractDeclarator(static_cast<AbstractDeclarator *>(this));
+  case NodeKind::POINTER_DECLARATOR:
+    return v->visitPointerDeclarator(static_cast<PointerDeclarator *>(this));
+  case NodeKind::FUNCTION_DECLARATOR:
+    return v->visitFunctionDeclarator(static_cast<FunctionDeclarator *>(this));
+  case NodeKind::COMPOUND_STMT:
+    return v->visitCompoundStmt(static_cast<CompoundStmt *>(this));
+  case NodeKind::IF_ELSE:
+    return v->visitIfElse(static_cast<IfElse *>(this));
+  case NodeKind::LABEL:
+    return v->visitLabel(static_cast<Label *>(this));
+  case NodeKind::WHILE:
+    return v->visitWhile(static_cast<While *>(this));
+  case NodeKind::GOTO:
+    return v->visitGoto(static_cast<Goto *>(this));
+  case NodeKind::EXPRESSION_STMT:
+    return v->visitExpressionStmt(static_cast<ExpressionStmt *>(this));
+  case NodeKind::BREAK:
+    return v->visitBreak(static_cast<Break *>(this));
+  case NodeKind::RETURN:
+    return v->visitReturn(static_cast<Return *>(this));
+  case NodeKind::CONTINUE:
+    return v->visitContinue(static_cast<Continue *>(this));
+  case NodeKind::VARIABLE_NAME:
+    return v->visitVariableName(static_cast<VariableName *>(this));
+  case NodeKind::NUMBER:
+    return v->visitNumber(static_cast<Number *>(this));
+  case NodeKind::CHARACTER:
+    return v->visitCharacter(static_cast<Character *>(this));
+  case NodeKind::STRING:
+    return v->visitString(static_cast<String *>(this));
+  case NodeKind::MEMBER_ACCESS_OP:
+    return v->visitMemberAccessOp(static_cast<MemberAccessOp *>(this));
+  case NodeKind::ARRAY_SUBSCRIPT_OP:
+    return v->visitArraySubscriptOp(static_cast<ArraySubscriptOp *>(this));
+  case NodeKind::FUNCTION_CALL:
+    return v->visitFunctionCall(static_cast<FunctionCall *>(this));
+  case NodeKind::UNARY:
+    return v->visitUnary(static_cast<Unary *>(this));
+  case NodeKind::SIZE_OF:
+    return v->visitSizeOf(static_cast<SizeOf *>(this));
+  case NodeKind::BINARY:
+    return v->visitBinary(static_cast<Binary *>(this));
+  case NodeKind::TERNARY:
+    return v->visitTernary(static_cast<Ternary *>(this));
+  case NodeKind::ASSIGNMENT:
+    return v->visitAssignment(static_cast<Assignment *>(this));
+  }
+  llvm_unreachable("unknown node kind");
+}
+
+void destroyTree(ASTNodeListType pending) {
+  while (!pending.empty()) {
+    auto node = std::move(pending.back());
+    pending.pop_back();
+    // children are detached first, so the destructor never recurses
+    if (node)
+      node->releaseChildren(pending);
+  }
+}
+
+TranslationUnit::TranslationUnit(const Token &tk,
+                                 ExternalDeclarationListType e)
+    : ASTNode(NodeKind::TRANSLATION_UNIT, tk), extern_list(std::move(e)) {
+  unsigned int id = 0;
+  preOrder(this, [&id](ASTNode *n) { n->setId(id++); });
+  table.resize(id);
+}
+
+TranslationUnit::~TranslationUnit() {
+  ASTNodeListType pending;
+  releaseChildren(pending);
+  destroyTree(std::move(pending));
+}
+
+void TranslationUnit::children(ASTNodeRefListType &out) {
+  for (const auto &c : extern_list)
+    if (c)
+      out.push_back(c.get());
+}
+
+void FunctionDefinition::children(ASTNodeRefListType &out) {
+  if (return_type)
+    out.push_back(return_type.get());
+  if (fn_name)
+    out.push_back(fn_name.get());
+  if (fn_body)
+    out.push_back(fn_body.get());
+}
+
+void FunctionDeclaration::children(ASTNodeRefListType &out) {
+  if (return_type)
+    out.push_back(return_type.get());
+  if (fn_name)
+    out.push_back(fn_name.get());
+}
+
+void DataDeclaration::children(ASTNodeRefListType &out) {
+  if (data_type)
+    out.push_back(data_type.get());
+  if (data_name)
+    out.push_back(data_name.get());
+}
+
+void StructDeclaration::children(ASTNodeRefListType &out) {
+  if (struct_type)
+    out.push_back(struct_type.get());
+  if (struct_alias)
+    out.push_back(struct_alias.get());
+}
+
+void ParamDeclaration::children(ASTNodeRefListType &out) {
+  if (param_type)
+    out.push_back(param_type.get());
+  if (param_name)
+    out.push_back(param_name.get());
 }
 
-std::string FunctionDefinition::accept(Visitor<std::string> *v) {
-  return v->visitFunctionDefinition(this);
+void StructType::children(ASTNodeRefListType &out) {
+  if (struct_name)
+    out.push_back(struct_name.get());
+  for (const auto &c : member_list)
+    if (c)
+      out.push_back(c.get());
 }
 
-std::string FunctionDeclaration::accept(Visitor<std::string> *v) {
-  return v->visitFunctionDeclaration(this);
+void AbstractType::children(ASTNodeRefListType &out) {
+  if (type)
+    out.push_back(type.get());
 }
 
-std::string DataDeclaration::accept(Visitor<std::string> *v) {
-  return v->visitDataDeclaration(this);
+void DirectDeclarator::children(ASTNodeRefListType &out) {
+  if (identifer)
+    out.push_back(identifer.get());
 }
 
-std::string StructDeclaration::accept(Visitor<std::string> *v) {
-  return v->visitStructDeclaration(this);
+void PointerDeclarator::children(ASTNodeRefListType &out) {
+  if (identifier)
+    out.push_back(identifier.get());
 }
 
-std::string ParamDeclaration::accept(Visitor<std::string> *v) {
-  return v->visitParamDeclaration(this);
+void FunctionDeclarator::children(ASTNodeRefListType &out) {
+  if (identifier)
+    out.push_back(identifier.get());
+  for (const auto &c : param_list)
+    if (c)
+      out.push_back(c.get());
+  if (return_ptr)
+    out.push_back(return_ptr.get());
 }
 
-std::string ScalarType::accept(Visitor<std::string> *v) {
-  return v->visitScalarType(this);
+void CompoundStmt::children(ASTNodeRefListType &out) {
+  for (const auto &c : block_items)
+    if (c)
+      out.push_back(c.get());
 }
 
-std::string StructType::accept(Visitor<std::string> *v) {
-  return v->visitStructType(this);
+void IfElse::children(ASTNodeRefListType &out) {
+  if (condition)
+    out.push_back(condition.get());
+  if (ifStmt)
+    out.push_back(ifStmt.get());
+  if (elseStmt)
+    out.push_back(elseStmt.get());
 }
 
-std::string AbstractType::accept(Visitor<std::string> *v) {
-  return v->visitAbstractType(this);
+void Label::children(ASTNodeRefListType &out) {
+  if (label_name)
+    out.push_back(label_name.get());
+  if (stmt)
+    out.push_back(stmt.get());
 }
 
-std::string DirectDeclarator::accept(Visitor<std::string> *v) {
-  return v->visitDirectDeclarator(this);
+void While::children(ASTNodeRefListType &out) {
+  if (predicate)
+    out.push_back(predicate.get());
+  if (block)
+    out.push_back(block.get());
 }
 
-std::string AbstractDeclarator::accept(Visitor<std::string> *v) {
-  return v->visitAbstractDeclarator(this);
+void Goto::children(ASTNodeRefListType &out) {
+  if (label_name)
+    out.push_back(label_name.get());
 }
 
-std::string PointerDeclarator::accept(Visitor<std::string> *v) {
-  return v->visitPointerDeclarator(this);
+void ExpressionStmt::children(ASTNodeRefListType &out) {
+  if (expr)
+    out.push_back(expr.get());
 }
 
-std::string FunctionDeclarator::accept(Visitor<std::string> *v) {
-  return v->visitFunctionDeclarator(this);
+void Return::children(ASTNodeRefListType &out) {
+  if (expr)
+    out.push_back(expr.get());
 }
 
-std::string CompoundStmt::accept(Visitor<std::string> *v) {
-  return v->visitCompoundStmt(this);
+void MemberAccessOp::children(ASTNodeRefListType &out) {
+  if (struct_name)
+    out.push_back(struct_name.get());
+  if (member_name)
+    out.push_back(member_name.get());
 }
 
-std::string IfElse::accept(Visitor<std::string> *v) {
-  return v->visitIfElse(this);
+void ArraySubscriptOp::children(ASTNodeRefListType &out) {
+  if (array_name)
+    out.push_back(array_name.get());
+  if (index_value)
+    out.push_back(index_value.get());
 }
 
-std::string Label::accept(Visitor<std::string> *v) {
-  return v->visitLabel(this);
+void FunctionCall::children(ASTNodeRefListType &out) {
+  if (callee_name)
+    out.push_back(callee_name.get());
+  for (const auto &c : callee_args)
+    if (c)
+      out.push_back(c.get());
 }
 
-std::string While::accept(Visitor<std::string> *v) {
-  return v->visitWhile(this);
+void Unary::children(ASTNodeRefListType &out) {
+  if (operand)
+    out.push_back(operand.get());
 }
 
-std::string Goto::accept(Visitor<std::string> *v) { return v->visitGoto(this); }
-
-std::string ExpressionStmt::accept(Visitor<std::string> *v) {
-  return v->visitExpressionStmt(this);
-}
-
-std::string Break::accept(Visitor<std::string> *v) {
-  return v->visitBreak(this);
+void SizeOf::children(ASTNodeRefListType &out) {
+  if (type_name)
+    out.push_back(type_name.get());
+  if (operand)
+    out.push_back(operand.get());
 }
 
-std::string Return::accept(Visitor<std::string> *v) {
-  return v->visitReturn(this);
+void Binary::children(ASTNodeRefListType &out) {
+  if (left_operand)
+    out.push_back(left_operand.get());
+  if (right_operand)
+    out.push_back(right_operand.get());
 }
 
-std::string Continue::accept(Visitor<std::string> *v) {
-  return v->visitContinue(this);
+void Ternary::children(ASTNodeRefListType &out) {
+  if (predicate)
+    out.push_back(predicate.get());
+  if (left_branch)
+    out.push_back(left_branch.get());
+  if (right_branch)
+    out.push_back(right_branch.get());
 }
 
-std::string VariableName::accept(Visitor<std::string> *v) {
-  return v->visitVariableName(this);
+void Assignment::children(ASTNodeRefListType &out) {
+  if (left_operand)
+    out.push_back(left_operand.get());
+  if (right_operand)
+    out.push_back(right_operand.get());
 }
 
-std::string Number::accept(Visitor<std::string> *v) {
-  return v->visitNumber(this);
+void TranslationUnit::releaseChildren(ASTNodeListType &out) {
+  for (auto &c : extern_list)
+    out.push_back(std::move(c));
+  extern_list.clear();
 }
 
-std::string Character::accept(Visitor<std::string> *v) {
-  return v->visitCharacter(this);
+void FunctionDefinition::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(return_type));
+  out.push_back(std::move(fn_name));
+  out.push_back(std::move(fn_body));
 }
 
-std::string String::accept(Visitor<std::string> *v) {
-  return v->visitString(this);
+void FunctionDeclaration::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(return_type));
+  out.push_back(std::move(fn_name));
 }
 
-std::string MemberAccessOp::accept(Visitor<std::string> *v) {
-  return v->visitMemberAccessOp(this);
+void DataDeclaration::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(data_type));
+  out.push_back(std::move(data_name));
 }
 
-std::string ArraySubscriptOp::accept(Visitor<std::string> *v) {
-  return v->visitArraySubscriptOp(this);
+void StructDeclaration::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(struct_type));
+  out.push_back(std::move(struct_alias));
 }
 
-std::string FunctionCall::accept(Visitor<std::string> *v) {
-  return v->visitFunctionCall(this);
+void ParamDeclaration::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(param_type));
+  out.push_back(std::move(param_name));
 }
 
-std::string Unary::accept(Visitor<std::string> *v) {
-  return v->visitUnary(this);
+void StructType::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(struct_name));
+  for (auto &c : member_list)
+    out.push_back(std::move(c));
+  member_list.clear();
 }
 
-std::string SizeOf::accept(Visitor<std::string> *v) {
-  return v->visitSizeOf(this);
+void AbstractType::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(type));
 }
 
-std::string Binary::accept(Visitor<std::string> *v) {
-  return v->visitBinary(this);
+void DirectDeclarator::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(identifer));
 }
 
-std::string Ternary::accept(Visitor<std::string> *v) {
-  return v->visitTernary(this);
+void PointerDeclarator::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(identifier));
 }
 
-std::string Assignment::accept(Visitor<std::string> *v) {
-  return v->visitAssignment(this);
+void FunctionDeclarator::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(identifier));
+  for (auto &c : param_list)
+    out.push_back(std::move(c));
+  param_list.clear();
+  out.push_back(std::move(return_ptr));
 }
 
-void TranslationUnit::accept(Visitor<void> *v) {
-  return v->visitTranslationUnit(this);
+void CompoundStmt::releaseChildren(ASTNodeListType &out) {
+  for (auto &c : block_items)
+    out.push_back(std::move(c));
+  block_items.clear();
 }
 
-void FunctionDefinition::accept(Visitor<void> *v) {
-  return v->visitFunctionDefinition(this);
+void IfElse::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(condition));
+  out.push_back(std::move(ifStmt));
+  out.push_back(std::move(elseStmt));
 }
 
-void FunctionDeclaration::accept(Visitor<void> *v) {
-  return v->visitFunctionDeclaration(this);
+void Label::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(label_name));
+  out.push_back(std::move(stmt));
 }
 
-void DataDeclaration::accept(Visitor<void> *v) {
-  return v->visitDataDeclaration(this);
+void While::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(predicate));
+  out.push_back(std::move(block));
 }
 
-void StructDeclaration::accept(Visitor<void> *v) {
-  return v->visitStructDeclaration(this);
+void Goto::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(label_name));
 }
 
-void ParamDeclaration::accept(Visitor<void> *v) {
-  return v->visitParamDeclaration(this);
+void ExpressionStmt::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(expr));
 }
 
-void ScalarType::accept(Visitor<void> *v) { return v->visitScalarType(this); }
-
-void StructType::accept(Visitor<void> *v) { return v->visitStructType(this); }
-
-void AbstractType::accept(Visitor<void> *v) {
-  return v->visitAbstractType(this);
+void Return::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(expr));
 }
 
-void DirectDeclarator::accept(Visitor<void> *v) {
-  return v->visitDirectDeclarator(this);
+void MemberAccessOp::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(struct_name));
+  out.push_back(std::move(member_name));
 }
 
-void AbstractDeclarator::accept(Visitor<void> *v) {
-  return v->visitAbstractDeclarator(this);
+void ArraySubscriptOp::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(array_name));
+  out.push_back(std::move(index_value));
 }
 
-void PointerDeclarator::accept(Visitor<void> *v) {
-  return v->visitPointerDeclarator(this);
+void FunctionCall::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(callee_name));
+  for (auto &c : callee_args)
+    out.push_back(std::move(c));
+  callee_args.clear();
 }
 
-void FunctionDeclarator::accept(Visitor<void> *v) {
-  return v->visitFunctionDeclarator(this);
+void Unary::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(operand));
 }
 
-void CompoundStmt::accept(Visitor<void> *v) {
-  return v->visitCompoundStmt(this);
+void SizeOf::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(type_name));
+  out.push_back(std::move(operand));
 }
 
-void IfElse::accept(Visitor<void> *v) { return v->visitIfElse(this); }
-
-void Label::accept(Visitor<void> *v) { return v->visitLabel(this); }
-
-void While::accept(Visitor<void> *v) { return v->visitWhile(this); }
-
-void Goto::accept(Visitor<void> *v) { return v->visitGoto(this); }
-
-void ExpressionStmt::accept(Visitor<void> *v) {
-  return v->visitExpressionStmt(this);
+void Binary::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(left_operand));
+  out.push_back(std::move(right_operand));
 }
 
-void Break::accept(Visitor<void> *v) { return v->visitBreak(this); }
-
-void Return::accept(Visitor<void> *v) { return v->visitReturn(this); }
-
-void Continue::accept(Visitor<void> *v) { return v->visitContinue(this); }
-
-void VariableName::accept(Visitor<void> *v) {
-  return v->visitVariableName(this);
+void Ternary::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(predicate));
+  out.push_back(std::move(left_branch));
+  out.push_back(std::move(right_branch));
 }
 
-void Number::accept(Visitor<void> *v) { return v->visitNumber(this); }
-
-void Character::accept(Visitor<void> *v) { return v->visitCharacter(this); }
-
-void String::accept(Visitor<void> *v) { return v->visitString(this); }
-
-void MemberAccessOp::accept(Visitor<void> *v) {
-  return v->visitMemberAccessOp(this);
+void Assignment::releaseChildren(ASTNodeListType &out) {
+  out.push_back(std::move(left_operand));
+  out.push_back(std::move(right_operand));
 }
 
-void ArraySubscriptOp::accept(Visitor<void> *v) {
-  return v->visitArraySubscriptOp(this);
+unsigned int Character::value() const {
+  if (char_value[0] != '\\')
+    return (unsigned int)(char_value[0]);
+  // value of escaped character
+  switch (char_value[1]) {
+  case 'a':
+    return 7;
+  case 'b':
+    return 8;
+  case 'f':
+    return 12;
+  case 'n':
+    return 10;
+  case 'r':
+    return 13;
+  case 't':
+    return 9;
+  case 'v':
+    return 11;
+  case '\\':
+    return 92;
+  case '\'':
+    return 39;
+  case '\"':
+    return 34;
+  case '?':
+    return 63;
+  default:
+    return 0;
+  }
 }
 
-void FunctionCall::accept(Visitor<void> *v) {
-  return v->visitFunctionCall(this);
+unsigned int SizeOf::value(const SemanticTable &table) const {
+  // sizeof sizeof
+  if (isa<SizeOf>(operand))
+    return 8;
+  // length of string without escape sequences but with tailing \0
+  if (auto s = dyn_cast<String>(operand)) {
+    auto str = s->str_value;
+    str.erase(std::remove(str.begin(), str.end(), '\\'), str.end());
+    return static_cast<unsigned int>(str.size() + 1);
+  }
+  if (operand)
+    return static_cast<unsigned int>(table.getType(*operand)->size());
+  if (table.getType(*type_name))
+    return static_cast<unsigned int>(table.getType(*type_name)->size());
+  return 0;
 }
-
-void Unary::accept(Visitor<void> *v) { return v->visitUnary(this); }
-
-void SizeOf::accept(Visitor<void> *v) { return v->visitSizeOf(this); }
-
-void Binary::accept(Visitor<void> *v) { return v->visitBinary(this); }
-
-void Ternary::accept(Visitor<void> *v) { return v->visitTernary(this); }
-
-void Assignment::accept(Visitor<void> *v) { return v->visitAssignment(this); }
 } // namespace ccc
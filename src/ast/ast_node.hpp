@@ -7,7 +7,8 @@
   friend SemanticVisitor;                                                      \
   friend GraphvizVisitor;                                                      \
   friend PrettyPrinterVisitor;                                                 \
-  friend CodegenVisitor;
+  friend CodegenVisitor;                                                       \
+  friend ConstantFoldingVisitor;
 #include "../lexer/token.hpp"
 #include "../utils/macros.hpp"
 #include "raw_type.hpp"
@@ -25,6 +26,7 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #include "llvm/IR/Value.h"
+#include "llvm/Support/ErrorHandling.h"
 
 #pragma GCC diagnostic pop
 namespace ccc {
@@ -64,8 +66,12 @@ class FunctionDeclarator;
 
 class CodegenVisitor;
 
+class ConstantFoldingVisitor;
+
 class String;
 
+class SizeOf;
+
 using DeclarationListType = std::vector<std::unique_ptr<Declaration>>;
 using ExternalDeclarationListType =
     std::vector<std::unique_ptr<ExternalDeclaration>>;
@@ -73,57 +79,208 @@ using ParamDeclarationListType = std::vector<std::unique_ptr<ParamDeclaration>>;
 using ExpressionListType = std::vector<std::unique_ptr<Expression>>;
 using StatementListType = std::vector<std::unique_ptr<Statement>>;
 using ASTNodeListType = std::vector<std::unique_ptr<ASTNode>>;
+using ASTNodeRefListType = std::vector<ASTNode *>;
+
+template <class Derived, class T> class StaticVisitor;
+
+/**
+ * tag of every concrete node class, used to dispatch visitors and to test types
+ * without virtual calls - ordered by class hierarchy, so abstract classes cover
+ * a contiguous range
+ */
+enum class NodeKind : unsigned char {
+  TRANSLATION_UNIT,
+  FUNCTION_DEFINITION,
+  FUNCTION_DECLARATION,
+  DATA_DECLARATION,
+  STRUCT_DECLARATION,
+  PARAM_DECLARATION,
+  SCALAR_TYPE,
+  STRUCT_TYPE,
+  ABSTRACT_TYPE,
+  DIRECT_DECLARATOR,
+  ABSTRACT_DECLARATOR,
+  POINTER_DECLARATOR,
+  FUNCTION_DECLARATOR,
+  COMPOUND_STMT,
+  IF_ELSE,
+  LABEL,
+  WHILE,
+  GOTO,
+  EXPRESSION_STMT,
+  BREAK,
+  RETURN,
+  CONTINUE,
+  VARIABLE_NAME,
+  NUMBER,
+  CHARACTER,
+  STRING,
+  MEMBER_ACCESS_OP,
+  ARRAY_SUBSCRIPT_OP,
+  FUNCTION_CALL,
+  UNARY,
+  SIZE_OF,
+  BINARY,
+  TERNARY,
+  ASSIGNMENT
+};
 
 /**
  * base class for all nodes in AST
  */
 class ASTNode {
-  Token tok;
-  std::string uIdentifier;
-  std::shared_ptr<RawType> uType;
+  NodeKind kind;
+  // pre-order index inside the translation unit, key into the side tables
+  unsigned int id = 0;
+  Location loc;
 
 protected:
-  explicit ASTNode(Token tk) : tok(std::move(tk)) {}
+  ASTNode(NodeKind k, const Token &tk) : kind(k), loc(tk.getLocation()) {}
 
 public:
   virtual ~ASTNode() = default;
-  virtual std::string accept(Visitor<std::string> *) = 0;
-  virtual void accept(Visitor<void> *) = 0;
 
-  Token &getTokenRef() { return tok; }
+  NodeKind getKind() const { return kind; }
+
+  static bool classof(const ASTNode *) { return true; }
+
+  /**
+   * dispatch to the dynamic visitor matching the node kind
+   *
+   * @param v visitor
+   * @return string
+   */
+  std::string accept(Visitor<std::string> *v);
+
+  /**
+   * dispatch to the static visitor matching the node kind, the visit is
+   * resolved at compile time
+   *
+   * @param v visitor
+   * @return result of the visit
+   */
+  template <class Derived, class T> T accept(StaticVisitor<Derived, T> *v) {
+    return v->visit(this);
+  }
+
+  const Location &getLocation() const { return loc; }
+
+  unsigned int getId() const { return id; }
+
+  void setId(unsigned int i) { id = i; }
 
   unsigned long hash() { return (unsigned long)this; }
 
   virtual bool isLValue() { return false; }
 
-  void setUIdentifier(std::string i) { uIdentifier = std::move(i); }
+  /**
+   * append direct children in source order, empty slots are skipped
+   *
+   * @param out list to append to
+   */
+  virtual void children(ASTNodeRefListType &out) { UNUSED(out); }
+
+  /**
+   * move ownership of direct children into out, used for tearing down trees
+   * without recursion
+   *
+   * @param out list to append to
+   */
+  virtual void releaseChildren(ASTNodeListType &out) { UNUSED(out); }
+};
+
+/**
+ * destroy all given subtrees with an explicit stack instead of recursive
+ * destructor calls, so arbitrary deep trees can be freed
+ *
+ * @param pending subtrees to destroy
+ */
+void destroyTree(ASTNodeListType pending);
+
+/**
+ * results of semantic analysis for all nodes of a translation unit, kept in
+ * dense tables indexed by node id instead of inside every node
+ */
+class SemanticTable {
+  std::vector<RawType *> types;
+  // symbol ids, 0 for nodes which don't declare or reference a symbol
+  std::vector<unsigned int> symbols;
+
+public:
+  /**
+   * make room for the node ids [0, n)
+   *
+   * @param n number of nodes
+   */
+  void resize(std::size_t n) {
+    types.resize(n);
+    symbols.resize(n);
+  }
+
+  RawType *getType(const ASTNode &n) const { return types[n.getId()]; }
+
+  void setType(const ASTNode &n, RawType *t) { types[n.getId()] = t; }
 
-  std::string getUIdentifier() { return uIdentifier; }
+  unsigned int getSymbol(const ASTNode &n) const {
+    return symbols[n.getId()];
+  }
+
+  void setSymbol(const ASTNode &n, unsigned int s) { symbols[n.getId()] = s; }
 
-  void setUType(std::shared_ptr<RawType> t) { uType = t; }
+  std::size_t size() const { return symbols.size(); }
 
-  std::shared_ptr<RawType> getUType() { return uType; }
+  /**
+   * @return one more than the largest symbol id, for tables indexed by symbol
+   */
+  unsigned int symbolCount() const {
+    if (symbols.empty())
+      return 0;
+    return *std::max_element(symbols.begin(), symbols.end()) + 1;
+  }
 
-  virtual StructType *getStructType() { return nullptr; }
+  /**
+   * @return size of the tables in bytes, without the pointed-to types
+   */
+  std::size_t bytes() const {
+    return types.capacity() * sizeof(RawType *) +
+           symbols.capacity() * sizeof(unsigned int);
+  }
 };
 
 class TranslationUnit : public ASTNode {
   FRIENDS
   ExternalDeclarationListType extern_list;
+  TypeContext types;
+  SemanticTable table;
 
 public:
-  explicit TranslationUnit(const Token &tk, ExternalDeclarationListType e)
-      : ASTNode(tk), extern_list(std::move(e)) {}
+  /**
+   * takes ownership of the declarations and numbers all nodes in pre-order
+   */
+  explicit TranslationUnit(const Token &tk, ExternalDeclarationListType e);
+  ~TranslationUnit() override;
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  TypeContext &getTypeContext() { return types; }
+
+  SemanticTable &getSemanticTable() { return table; }
+
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::TRANSLATION_UNIT;
+  }
 };
 
 class Type : public ASTNode {
 protected:
-  explicit Type(const Token &tk) : ASTNode(tk) {}
+  Type(NodeKind k, const Token &tk) : ASTNode(k, tk) {}
 
-  virtual bool isStructType() { return false; }
+public:
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::SCALAR_TYPE &&
+           n->getKind() <= NodeKind::ABSTRACT_TYPE;
+  }
 };
 
 enum class ScalarTypeValue { VOID, CHAR, INT };
@@ -133,10 +290,12 @@ class ScalarType : public Type {
   ScalarTypeValue type_kind;
 
 public:
-  ScalarType(const Token &tk, ScalarTypeValue v) : Type(tk), type_kind(v) {}
+  ScalarType(const Token &tk, ScalarTypeValue v)
+      : Type(NodeKind::SCALAR_TYPE, tk), type_kind(v) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::SCALAR_TYPE;
+  }
 };
 
 class AbstractType : public Type {
@@ -146,10 +305,15 @@ class AbstractType : public Type {
 
 public:
   AbstractType(const Token &tk, std::unique_ptr<Type> v, int ptr_count)
-      : Type(tk), type(move(v)), ptr_count(ptr_count) {}
+      : Type(NodeKind::ABSTRACT_TYPE, tk), type(move(v)),
+        ptr_count(ptr_count) {}
+
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::ABSTRACT_TYPE;
+  }
 };
 
 class StructType : public Type {
@@ -157,29 +321,36 @@ class StructType : public Type {
   std::unique_ptr<VariableName> struct_name;
   ExternalDeclarationListType member_list;
 
-  bool isStructType() override { return true; }
-
   bool is_definition;
   std::vector<int> elem_size = {};
 
 public:
   StructType(const Token &tk, std::unique_ptr<VariableName> n)
-      : Type(tk), struct_name(std::move(n)), is_definition(false) {}
+      : Type(NodeKind::STRUCT_TYPE, tk), struct_name(std::move(n)),
+        is_definition(false) {}
 
   StructType(const Token &tk, std::unique_ptr<VariableName> n,
              ExternalDeclarationListType m)
-      : Type(tk), struct_name(std::move(n)), member_list(std::move(m)),
-        is_definition(true) {}
+      : Type(NodeKind::STRUCT_TYPE, tk), struct_name(std::move(n)),
+        member_list(std::move(m)), is_definition(true) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
-  StructType *getStructType() override { return this; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::STRUCT_TYPE;
+  }
 };
 
 class ExternalDeclaration : public ASTNode {
 protected:
-  explicit ExternalDeclaration(const Token &tk) : ASTNode(tk) {}
+  ExternalDeclaration(NodeKind k, const Token &tk) : ASTNode(k, tk) {}
+
+public:
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::FUNCTION_DEFINITION &&
+           n->getKind() <= NodeKind::PARAM_DECLARATION;
+  }
 };
 
 class FunctionDefinition : public ExternalDeclaration {
@@ -193,16 +364,27 @@ public:
   FunctionDefinition(const Token &tk, std::unique_ptr<Type> r,
                      std::unique_ptr<Declarator> n,
                      std::unique_ptr<Statement> b)
-      : ExternalDeclaration(tk), return_type(std::move(r)),
-        fn_name(std::move(n)), fn_body(std::move(b)) {}
+      : ExternalDeclaration(NodeKind::FUNCTION_DEFINITION, tk),
+        return_type(std::move(r)), fn_name(std::move(n)),
+        fn_body(std::move(b)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::FUNCTION_DEFINITION;
+  }
 };
 
 class Declaration : public ExternalDeclaration {
 protected:
-  explicit Declaration(const Token &tk) : ExternalDeclaration(tk) {}
+  Declaration(NodeKind k, const Token &tk) : ExternalDeclaration(k, tk) {}
+
+public:
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::FUNCTION_DECLARATION &&
+           n->getKind() <= NodeKind::PARAM_DECLARATION;
+  }
 };
 
 class FunctionDeclaration : public Declaration {
@@ -214,10 +396,15 @@ class FunctionDeclaration : public Declaration {
 public:
   FunctionDeclaration(const Token &tk, std::unique_ptr<Type> r,
                       std::unique_ptr<Declarator> n)
-      : Declaration(tk), return_type(std::move(r)), fn_name(std::move(n)) {}
+      : Declaration(NodeKind::FUNCTION_DECLARATION, tk),
+        return_type(std::move(r)), fn_name(std::move(n)) {}
+
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::FUNCTION_DECLARATION;
+  }
 };
 
 class DataDeclaration : public Declaration {
@@ -225,18 +412,20 @@ class DataDeclaration : public Declaration {
   std::unique_ptr<Type> data_type;
   std::unique_ptr<Declarator> data_name;
 
-  StructType *getStructType() override { return data_type->getStructType(); }
-
   bool global;
 
 public:
   DataDeclaration(const Token &tk, std::unique_ptr<Type> t,
                   std::unique_ptr<Declarator> n)
-      : Declaration(tk), data_type(std::move(t)), data_name(std::move(n)),
-        global(true) {}
+      : Declaration(NodeKind::DATA_DECLARATION, tk), data_type(std::move(t)),
+        data_name(std::move(n)), global(true) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::DATA_DECLARATION;
+  }
 };
 
 class StructDeclaration : public Declaration {
@@ -244,16 +433,18 @@ class StructDeclaration : public Declaration {
   std::unique_ptr<Type> struct_type;
   std::unique_ptr<Declarator> struct_alias;
 
-  StructType *getStructType() override { return struct_type->getStructType(); }
-
 public:
   StructDeclaration(const Token &tk, std::unique_ptr<Type> t,
                     std::unique_ptr<Declarator> a = nullptr)
-      : Declaration(tk), struct_type(std::move(t)), struct_alias(std::move(a)) {
-  }
+      : Declaration(NodeKind::STRUCT_DECLARATION, tk),
+        struct_type(std::move(t)), struct_alias(std::move(a)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::STRUCT_DECLARATION;
+  }
 };
 
 class ParamDeclaration : public Declaration {
@@ -264,22 +455,28 @@ class ParamDeclaration : public Declaration {
 public:
   ParamDeclaration(const Token &tk, std::unique_ptr<Type> t,
                    std::unique_ptr<Declarator> n = nullptr)
-      : Declaration(tk), param_type(std::move(t)), param_name(std::move(n)) {}
+      : Declaration(NodeKind::PARAM_DECLARATION, tk), param_type(std::move(t)),
+        param_name(std::move(n)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::PARAM_DECLARATION;
+  }
 };
 
 class Declarator : public ASTNode {
 protected:
-  explicit Declarator(const Token &tk) : ASTNode(tk) {}
+  Declarator(NodeKind k, const Token &tk) : ASTNode(k, tk) {}
 
 public:
   virtual std::unique_ptr<VariableName> *getIdentifier() = 0;
 
-  virtual AbstractDeclarator *getAbstractDeclarator() { return nullptr; };
-
-  virtual FunctionDeclarator *getFunctionDeclarator() { return nullptr; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::DIRECT_DECLARATOR &&
+           n->getKind() <= NodeKind::FUNCTION_DECLARATOR;
+  }
 };
 
 class DirectDeclarator : public Declarator {
@@ -290,10 +487,14 @@ class DirectDeclarator : public Declarator {
 
 public:
   DirectDeclarator(const Token &tk, std::unique_ptr<VariableName> i)
-      : Declarator(tk), identifer(std::move(i)) {}
+      : Declarator(NodeKind::DIRECT_DECLARATOR, tk), identifer(std::move(i)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::DIRECT_DECLARATOR;
+  }
 };
 
 enum class AbstractDeclType { Data, Function };
@@ -308,12 +509,12 @@ public:
   unsigned int pointerCount = 0;
 
   AbstractDeclarator(const Token &tk, AbstractDeclType t, unsigned int p)
-      : Declarator(tk), type_kind(t), pointerCount(p) {}
+      : Declarator(NodeKind::ABSTRACT_DECLARATOR, tk), type_kind(t),
+        pointerCount(p) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
-
-  AbstractDeclarator *getAbstractDeclarator() override { return this; };
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::ABSTRACT_DECLARATOR;
+  }
 };
 
 class PointerDeclarator : public Declarator {
@@ -330,10 +531,15 @@ class PointerDeclarator : public Declarator {
 public:
   explicit PointerDeclarator(const Token &tk,
                              std::unique_ptr<Declarator> i = nullptr, int l = 1)
-      : Declarator(tk), identifier(std::move(i)), indirection_level(l) {}
+      : Declarator(NodeKind::POINTER_DECLARATOR, tk), identifier(std::move(i)),
+        indirection_level(l) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::POINTER_DECLARATOR;
+  }
 };
 
 class FunctionDeclarator : public Declarator {
@@ -346,22 +552,30 @@ public:
   FunctionDeclarator(const Token &tk, std::unique_ptr<Declarator> i,
                      ParamDeclarationListType p,
                      std::unique_ptr<Declarator> r = nullptr)
-      : Declarator(tk), identifier(std::move(i)), param_list(std::move(p)),
-        return_ptr(std::move(r)) {}
+      : Declarator(NodeKind::FUNCTION_DECLARATOR, tk), identifier(std::move(i)),
+        param_list(std::move(p)), return_ptr(std::move(r)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
   std::unique_ptr<VariableName> *getIdentifier() override {
     return identifier->getIdentifier();
   }
 
-  FunctionDeclarator *getFunctionDeclarator() override { return this; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::FUNCTION_DECLARATOR;
+  }
 };
 
 class Statement : public ASTNode {
 protected:
-  explicit Statement(const Token &tk) : ASTNode(tk) {}
+  Statement(NodeKind k, const Token &tk) : ASTNode(k, tk) {}
+
+public:
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::COMPOUND_STMT &&
+           n->getKind() <= NodeKind::CONTINUE;
+  }
 };
 
 class CompoundStmt : public Statement {
@@ -370,10 +584,14 @@ class CompoundStmt : public Statement {
 
 public:
   CompoundStmt(const Token &tk, ASTNodeListType block)
-      : Statement(tk), block_items(std::move(block)) {}
+      : Statement(NodeKind::COMPOUND_STMT, tk), block_items(std::move(block)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::COMPOUND_STMT;
+  }
 };
 
 class IfElse : public Statement {
@@ -385,11 +603,15 @@ class IfElse : public Statement {
 public:
   IfElse(const Token &tk, std::unique_ptr<Expression> c,
          std::unique_ptr<Statement> i, std::unique_ptr<Statement> e = nullptr)
-      : Statement(tk), condition(std::move(c)), ifStmt(std::move(i)),
-        elseStmt(std::move(e)) {}
+      : Statement(NodeKind::IF_ELSE, tk), condition(std::move(c)),
+        ifStmt(std::move(i)), elseStmt(std::move(e)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::IF_ELSE;
+  }
 };
 
 class Label : public Statement {
@@ -400,10 +622,15 @@ class Label : public Statement {
 public:
   Label(const Token &tk, std::unique_ptr<VariableName> e,
         std::unique_ptr<Statement> b)
-      : Statement(tk), label_name(std::move(e)), stmt(std::move(b)) {}
+      : Statement(NodeKind::LABEL, tk), label_name(std::move(e)),
+        stmt(std::move(b)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::LABEL;
+  }
 };
 
 class While : public Statement {
@@ -414,10 +641,15 @@ class While : public Statement {
 public:
   While(const Token &tk, std::unique_ptr<Expression> e,
         std::unique_ptr<Statement> b)
-      : Statement(tk), predicate(std::move(e)), block(std::move(b)) {}
+      : Statement(NodeKind::WHILE, tk), predicate(std::move(e)),
+        block(std::move(b)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::WHILE;
+  }
 };
 
 class Goto : public Statement {
@@ -426,10 +658,14 @@ class Goto : public Statement {
 
 public:
   Goto(const Token &tk, std::unique_ptr<VariableName> e)
-      : Statement(tk), label_name(std::move(e)) {}
+      : Statement(NodeKind::GOTO, tk), label_name(std::move(e)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::GOTO;
+  }
 };
 
 class ExpressionStmt : public Statement {
@@ -438,18 +674,23 @@ class ExpressionStmt : public Statement {
 
 public:
   ExpressionStmt(const Token &tk, std::unique_ptr<Expression> e)
-      : Statement(tk), expr(std::move(e)) {}
+      : Statement(NodeKind::EXPRESSION_STMT, tk), expr(std::move(e)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::EXPRESSION_STMT;
+  }
 };
 
 class Break : public Statement {
 public:
-  explicit Break(const Token &tk) : Statement(tk) {}
+  explicit Break(const Token &tk) : Statement(NodeKind::BREAK, tk) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::BREAK;
+  }
 };
 
 class Return : public Statement {
@@ -458,32 +699,34 @@ class Return : public Statement {
 
 public:
   explicit Return(const Token &tk, std::unique_ptr<Expression> e = nullptr)
-      : Statement(tk), expr(std::move(e)) {}
+      : Statement(NodeKind::RETURN, tk), expr(std::move(e)) {}
+
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::RETURN;
+  }
 };
 
 class Continue : public Statement {
 public:
-  explicit Continue(const Token &tk) : Statement(tk) {}
+  explicit Continue(const Token &tk) : Statement(NodeKind::CONTINUE, tk) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::CONTINUE;
+  }
 };
 
 class Expression : public ASTNode {
 protected:
-  explicit Expression(const Token &tk) : ASTNode(tk) {}
+  Expression(NodeKind k, const Token &tk) : ASTNode(k, tk) {}
 
 public:
-  virtual VariableName *getVariableName() { return nullptr; }
-
-  virtual Number *getNumber() { return nullptr; }
-
-  virtual String *getString() { return nullptr; }
-
-  virtual bool isSizeOf() { return false; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() >= NodeKind::VARIABLE_NAME &&
+           n->getKind() <= NodeKind::ASSIGNMENT;
+  }
 };
 
 class VariableName : public Expression {
@@ -493,18 +736,17 @@ class VariableName : public Expression {
 
 public:
   VariableName(const Token &tk, std::string n)
-      : Expression(tk), name(std::move(n)) {}
-
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+      : Expression(NodeKind::VARIABLE_NAME, tk), name(std::move(n)) {}
 
   int Compare(const VariableName &d) const { return d.name == name; }
 
   bool operator==(const VariableName &d) const { return !Compare(d); }
 
-  VariableName *getVariableName() override { return this; }
-
   bool isLValue() override { return true; }
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::VARIABLE_NAME;
+  }
 };
 
 class Number : public Expression {
@@ -512,12 +754,12 @@ class Number : public Expression {
   long num_value;
 
 public:
-  Number(const Token &tk, long v) : Expression(tk), num_value(v) {}
+  Number(const Token &tk, long v)
+      : Expression(NodeKind::NUMBER, tk), num_value(v) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
-
-  Number *getNumber() override { return this; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::NUMBER;
+  }
 };
 
 class Character : public Expression {
@@ -525,24 +767,31 @@ class Character : public Expression {
   std::string char_value;
 
 public:
-  Character(const Token &tk, std::string c) : Expression(tk), char_value(c) {}
+  Character(const Token &tk, std::string c)
+      : Expression(NodeKind::CHARACTER, tk), char_value(c) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  /**
+   * @return value of the character with escape sequences replaced
+   */
+  unsigned int value() const;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::CHARACTER;
+  }
 };
 
 class String : public Expression {
   FRIENDS
+  friend SizeOf;
   std::string str_value;
 
 public:
   String(const Token &tk, std::string v)
-      : Expression(tk), str_value(std::move(v)) {}
+      : Expression(NodeKind::STRING, tk), str_value(std::move(v)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
-
-  String *getString() override { return this; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::STRING;
+  }
 };
 
 enum class PostFixOpValue { DOT, ARROW };
@@ -556,13 +805,17 @@ class MemberAccessOp : public Expression {
 public:
   MemberAccessOp(const Token &tk, PostFixOpValue o,
                  std::unique_ptr<Expression> s, std::unique_ptr<Expression> m)
-      : Expression(tk), op_kind(o), struct_name(std::move(s)),
-        member_name(std::move(m)) {}
+      : Expression(NodeKind::MEMBER_ACCESS_OP, tk), op_kind(o),
+        struct_name(std::move(s)), member_name(std::move(m)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
   bool isLValue() override { return true; }
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::MEMBER_ACCESS_OP;
+  }
 };
 
 class ArraySubscriptOp : public Expression {
@@ -573,12 +826,17 @@ class ArraySubscriptOp : public Expression {
 public:
   ArraySubscriptOp(const Token &tk, std::unique_ptr<Expression> a,
                    std::unique_ptr<Expression> i)
-      : Expression(tk), array_name(std::move(a)), index_value(std::move(i)) {}
+      : Expression(NodeKind::ARRAY_SUBSCRIPT_OP, tk), array_name(std::move(a)),
+        index_value(std::move(i)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
   bool isLValue() override { return true; }
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::ARRAY_SUBSCRIPT_OP;
+  }
 };
 
 // Function call
@@ -590,10 +848,15 @@ class FunctionCall : public Expression {
 public:
   FunctionCall(const Token &tk, std::unique_ptr<Expression> n,
                ExpressionListType a)
-      : Expression(tk), callee_name(std::move(n)), callee_args(std::move(a)) {}
+      : Expression(NodeKind::FUNCTION_CALL, tk), callee_name(std::move(n)),
+        callee_args(std::move(a)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::FUNCTION_CALL;
+  }
 };
 
 enum class UnaryOpValue { ADDRESS_OF = 0, DEREFERENCE, MINUS, NOT };
@@ -605,14 +868,16 @@ class Unary : public Expression {
 
 public:
   Unary(const Token &tk, UnaryOpValue v, std::unique_ptr<Expression> o)
-      : Expression(tk), op_kind(v), operand(std::move(o)) {}
+      : Expression(NodeKind::UNARY, tk), op_kind(v), operand(std::move(o)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
-
-  Number *getNumber() override { return operand->getNumber(); };
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
   bool isLValue() override { return true; }
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::UNARY;
+  }
 };
 
 class SizeOf : public Expression {
@@ -622,15 +887,23 @@ class SizeOf : public Expression {
 
 public:
   SizeOf(const Token &tk, std::unique_ptr<Type> n)
-      : Expression(tk), type_name(std::move(n)) {}
+      : Expression(NodeKind::SIZE_OF, tk), type_name(std::move(n)) {}
 
   SizeOf(const Token &tk, std::unique_ptr<Expression> o)
-      : Expression(tk), operand(std::move(o)) {}
+      : Expression(NodeKind::SIZE_OF, tk), operand(std::move(o)) {}
+
+  /**
+   * @param table results of semantic analysis
+   * @return size of the type or of the type of the expression in bytes
+   */
+  unsigned int value(const SemanticTable &table) const;
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
 
-  bool isSizeOf() override { return true; }
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::SIZE_OF;
+  }
 };
 
 enum class BinaryOpValue {
@@ -654,11 +927,15 @@ class Binary : public Expression {
 public:
   Binary(const Token &tk, BinaryOpValue v, std::unique_ptr<Expression> l,
          std::unique_ptr<Expression> r)
-      : Expression(tk), op_kind(v), left_operand(std::move(l)),
-        right_operand(std::move(r)) {}
+      : Expression(NodeKind::BINARY, tk), op_kind(v),
+        left_operand(std::move(l)), right_operand(std::move(r)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::BINARY;
+  }
 };
 
 class Ternary : public Expression {
@@ -670,11 +947,15 @@ class Ternary : public Expression {
 public:
   Ternary(const Token &tk, std::unique_ptr<Expression> c,
           std::unique_ptr<Expression> l, std::unique_ptr<Expression> r)
-      : Expression(tk), predicate(std::move(c)), left_branch(std::move(l)),
-        right_branch(std::move(r)) {}
+      : Expression(NodeKind::TERNARY, tk), predicate(std::move(c)),
+        left_branch(std::move(l)), right_branch(std::move(r)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::TERNARY;
+  }
 };
 
 class Assignment : public Expression {
@@ -685,11 +966,15 @@ class Assignment : public Expression {
 public:
   Assignment(const Token &tk, std::unique_ptr<Expression> l,
              std::unique_ptr<Expression> r)
-      : Expression(tk), left_operand(std::move(l)),
+      : Expression(NodeKind::ASSIGNMENT, tk), left_operand(std::move(l)),
         right_operand(std::move(r)) {}
 
-  std::string accept(Visitor<std::string> *) override;
-  void accept(Visitor<void> *) override;
+  void children(ASTNodeRefListType &) override;
+  void releaseChildren(ASTNodeListType &) override;
+
+  static bool classof(const ASTNode *n) {
+    return n->getKind() == NodeKind::ASSIGNMENT;
+  }
 };
 
 /**
@@ -738,6 +1023,106 @@ public:
   virtual T visitTernary(Ternary *) = 0;
   virtual T visitAssignment(Assignment *) = 0;
 };
+
+/**
+ * visitor dispatching on the node kind at compile time - derived classes
+ * implement all visit methods without virtual calls, so they can be inlined,
+ * and choose their own return type
+ *
+ * @tparam Derived implementing visitor
+ * @tparam T return type of all visits
+ */
+template <class Derived, class T> class StaticVisitor {
+protected:
+  StaticVisitor() = default;
+  ~StaticVisitor() = default;
+
+public:
+  /**
+   * call the visit method of the derived visitor matching the node kind
+   *
+   * @param v node
+   * @return result of the visit
+   */
+  T visit(ASTNode *v) {
+    auto self = static_cast<Derived *>(this);
+    switch (v->getKind()) {
+    case NodeKind::TRANSLATION_UNIT:
+      return self->visitTranslationUnit(static_cast<TranslationUnit *>(v));
+    case NodeKind::FUNCTION_DEFINITION:
+      return self->visitFunctionDefinition(
+          static_cast<FunctionDefinition *>(v));
+    case NodeKind::FUNCTION_DECLARATION:
+      return self->visitFunctionDeclaration(
+          static_cast<FunctionDeclaration *>(v));
+    case NodeKind::DATA_DECLARATION:
+      return self->visitDataDeclaration(static_cast<DataDeclaration *>(v));
+    case NodeKind::STRUCT_DECLARATION:
+      return self->visitStructDeclaration(static_cast<StructDeclaration *>(v));
+    case NodeKind::PARAM_DECLARATION:
+      return self->visitParamDeclaration(static_cast<ParamDeclaration *>(v));
+    case NodeKind::SCALAR_TYPE:
+      return self->visitScalarType(static_cast<ScalarType *>(v));
+    case NodeKind::STRUCT_TYPE:
+      return self->visitStructType(static_cast<StructType *>(v));
+    case NodeKind::ABSTRACT_TYPE:
+      return self->visitAbstractType(static_cast<AbstractType *>(v));
+    case NodeKind::DIRECT_DECLARATOR:
+      return self->visitDirectDeclarator(static_cast<DirectDeclarator *>(v));
+    case NodeKind::ABSTRACT_DECLARATOR:
+      return self->visitAbstractDeclarator(
+          static_cast<AbstractDeclarator *>(v));
+    case NodeKind::POINTER_DECLARATOR:
+      return self->visitPointerDeclarator(static_cast<PointerDeclarator *>(v));
+    case NodeKind::FUNCTION_DECLARATOR:
+      return self->visitFunctionDeclarator(
+          static_cast<FunctionDeclarator *>(v));
+    case NodeKind::COMPOUND_STMT:
+      return self->visitCompoundStmt(static_cast<CompoundStmt *>(v));
+    case NodeKind::IF_ELSE:
+      return self->visitIfElse(static_cast<IfElse *>(v));
+    case NodeKind::LABEL:
+      return self->visitLabel(static_cast<Label *>(v));
+    case NodeKind::WHILE:
+      return self->visitWhile(static_cast<While *>(v));
+    case NodeKind::GOTO:
+      return self->visitGoto(static_cast<Goto *>(v));
+    case NodeKind::EXPRESSION_STMT:
+      return self->visitExpressionStmt(static_cast<ExpressionStmt *>(v));
+    case NodeKind::BREAK:
+      return self->visitBreak(static_cast<Break *>(v));
+    case NodeKind::RETURN:
+      return self->visitReturn(static_cast<Return *>(v));
+    case NodeKind::CONTINUE:
+      return self->visitContinue(static_cast<Continue *>(v));
+    case NodeKind::VARIABLE_NAME:
+      return self->visitVariableName(static_cast<VariableName *>(v));
+    case NodeKind::NUMBER:
+      return self->visitNumber(static_cast<Number *>(v));
+    case NodeKind::CHARACTER:
+      return self->visitCharacter(static_cast<Character *>(v));
+    case NodeKind::STRING:
+      return self->visitString(static_cast<String *>(v));
+    case NodeKind::MEMBER_ACCESS_OP:
+      return self->visitMemberAccessOp(static_cast<MemberAccessOp *>(v));
+    case NodeKind::ARRAY_SUBSCRIPT_OP:
+      return self->visitArraySubscriptOp(static_cast<ArraySubscriptOp *>(v));
+    case NodeKind::FUNCTION_CALL:
+      return self->visitFunctionCall(static_cast<FunctionCall *>(v));
+    case NodeKind::UNARY:
+      return self->visitUnary(static_cast<Unary *>(v));
+    case NodeKind::SIZE_OF:
+      return self->visitSizeOf(static_cast<SizeOf *>(v));
+    case NodeKind::BINARY:
+      return self->visitBinary(static_cast<Binary *>(v));
+    case NodeKind::TERNARY:
+      return self->visitTernary(static_cast<Ternary *>(v));
+    case NodeKind::ASSIGNMENT:
+      return self->visitAssignment(static_cast<Assignment *>(v));
+    }
+    llvm_unreachable("unknown node kind");
+  }
+};
 } // namespace ccc
 
 #endif // C4_ASTNODE_HPP
@@ -0,0 +1,86 @@
+#ifndef C4_DIAGNOSTICS_HPP
+#define C4_DIAGNOSTICS_HPP
+#include "../utils/location.hpp"
+#include "../utils/macros.hpp"
+#include "raw_type.hpp"
+#include <string>
+#include <vector>
+
+namespace ccc {
+/**
+ * argument of a diagnostic, types are kept as they are and only printed when
+ * the message gets formatted
+ */
+class DiagnosticArg {
+  std::string text;
+  RawType *type = nullptr;
+
+public:
+  DiagnosticArg(std::string text) : text(std::move(text)) {}
+  DiagnosticArg(const char *text) : text(text) {}
+  DiagnosticArg(RawType *type) : type(type) {}
+
+  std::string print() const { return type ? type->print() : text; }
+};
+
+/**
+ * recorded error, format is a static message with placeholders %0 to %9
+ */
+struct Diagnostic {
+  Location loc;
+  const char *format;
+  std::vector<DiagnosticArg> args;
+
+  Diagnostic(const Location &loc, const char *format,
+             std::vector<DiagnosticArg> args)
+      : loc(loc), format(format), args(std::move(args)) {}
+};
+
+/**
+ * collects diagnostics without building any strings, messages are formatted
+ * on demand when they get printed
+ */
+class DiagnosticsEngine {
+  std::vector<Diagnostic> diagnostics;
+
+public:
+  /**
+   * record an error
+   *
+   * @param loc location in source
+   * @param format message with placeholders
+   * @param args values of placeholders
+   * @return false, to be returned as failed status
+   */
+  template <typename... Args>
+  bool error(const Location &loc, const char *format, Args &&... args) {
+    diagnostics.emplace_back(
+        loc, format,
+        std::vector<DiagnosticArg>{DiagnosticArg(std::forward<Args>(args))...});
+    return false;
+  }
+
+  bool empty() const { return diagnostics.empty(); }
+
+  std::size_t size() const { return diagnostics.size(); }
+
+  /**
+   * @param i index of diagnostic
+   * @return message in the format of SEMANTIC_ERROR
+   */
+  std::string format(std::size_t i) const {
+    const auto &d = diagnostics[i];
+    std::string msg;
+    for (const char *c = d.format; *c; c++) {
+      if (*c == '%' && c[1] >= '0' && c[1] <= '9') {
+        msg += d.args[static_cast<std::size_t>(*++c - '0')].print();
+        continue;
+      }
+      msg += *c;
+    }
+    return SEMANTIC_ERROR(d.loc.getLine(), d.loc.getColumn(), msg);
+  }
+};
+} // namespace ccc
+
+#endif // C4_DIAGNOSTICS_HPP
@@ -2,10 +2,15 @@
 #define C4_RAW_TYPE_HPP
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
-#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Type.h"
 
 #pragma GCC diagnostic pop
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 namespace ccc {
 class GraphvizVisitor;
 
@@ -15,8 +20,10 @@ class SemanticVisitor;
 
 class CodegenVisitor;
 
+class ConstantFoldingVisitor;
+
 /**
- * object type
+ * object type, scalar values come first so they form a contiguous range
  */
 enum class RawTypeValue { NIL, VOID, CHAR, INT, POINTER, FUNCTION, STRUCT };
 
@@ -28,16 +35,34 @@ class RawFunctionType;
 
 class RawStructType;
 
+class TypeContext;
+
+class LLVMTypeCache;
+
 /**
  * object structure for type representation used in semantical analysis instead
  * of AST nodes
  */
 class RawType {
   FRIENDS
+  friend TypeContext;
+  friend LLVMTypeCache;
+
 protected:
-  RawType() = default;
+  explicit RawType(RawTypeValue v) : type_kind(v) {}
   virtual ~RawType() = default;
+  RawTypeValue type_kind;
   std::vector<int> elem_size = {};
+  // dense index inside the TypeContext, given on creation
+  unsigned int id = 0;
+
+  /**
+   * create the LLVM type, only called once per context by LLVMTypeCache
+   *
+   * @param types cache for the LLVM types of contained types
+   * @return type, nullptr if there is no LLVM equivalent
+   */
+  virtual llvm::Type *buildLLVMType(LLVMTypeCache &) { return nullptr; }
 
 public:
   virtual std::string print() = 0;
@@ -46,37 +71,46 @@ public:
    * returns type of class as enum
    * @return type
    */
-  virtual RawTypeValue getRawTypeValue() = 0;
+  RawTypeValue getRawTypeValue() const { return type_kind; }
 
   // handle distinct members without casting
-  virtual std::shared_ptr<RawType> deref() { return nullptr; }
+  virtual RawType *deref() { return nullptr; }
 
-  virtual std::vector<std::shared_ptr<RawType>> get_param() { return {}; }
+  virtual std::vector<RawType *> get_param() { return {}; }
 
-  virtual std::shared_ptr<RawType> get_return() { return nullptr; }
+  virtual RawType *get_return() { return nullptr; }
 
   /**
    * decide if types are castable into each other
    *
    * @return bool
    */
-  virtual bool compare_equal(const std::shared_ptr<RawType> &) { return false; }
+  virtual bool compare_equal(RawType *) { return false; }
 
   /**
-   * decide if types are the same
+   * decide if types are the same - types are unique inside their TypeContext,
+   * so apart from null constants and integers of different width this is a
+   * pointer comparison
    *
    * @return bool
    */
-  virtual bool compare_exact(const std::shared_ptr<RawType> &) { return false; }
-
-  // wrapper
-  virtual RawScalarType *getRawScalarType() { return nullptr; }
-
-  virtual RawPointerType *getRawPointerType() { return nullptr; }
-
-  virtual RawFunctionType *getRawFunctionType() { return nullptr; }
-
-  virtual RawStructType *getRawStructType() { return nullptr; }
+  bool compare_exact(RawType *b) {
+    if (b == this)
+      return true;
+    if (b == nullptr)
+      return false;
+    switch (b->type_kind) {
+    case RawTypeValue::NIL:
+      return type_kind == RawTypeValue::INT || type_kind == RawTypeValue::NIL ||
+             type_kind == RawTypeValue::POINTER ||
+             type_kind == RawTypeValue::FUNCTION;
+    case RawTypeValue::INT:
+    case RawTypeValue::CHAR:
+      return type_kind == b->type_kind || type_kind == RawTypeValue::NIL;
+    default:
+      return false;
+    }
+  }
 
   /**
    * called on pointer to decide
@@ -85,11 +119,13 @@ public:
    */
   virtual bool isVoidPtr() { return false; }
 
-  // generate LLVM types
-  virtual llvm::Type *getLLVMType(llvm::IRBuilder<>) { return nullptr; }
+  unsigned int getId() const { return id; }
 
-  virtual llvm::FunctionType *getLLVMFunctionType(llvm::IRBuilder<>) {
-    return nullptr;
+  // generate LLVM types, memoised per context
+  llvm::Type *getLLVMType(LLVMTypeCache &types);
+
+  llvm::FunctionType *getLLVMFunctionType(LLVMTypeCache &types) {
+    return llvm::dyn_cast_or_null<llvm::FunctionType>(getLLVMType(types));
   }
 
   /**
@@ -108,44 +144,44 @@ public:
 
 class RawFunctionType : public RawType {
   FRIENDS
-  std::shared_ptr<RawType> ret_type;
-  std::vector<std::shared_ptr<RawType>> param_types;
+  RawType *ret_type;
+  std::vector<RawType *> param_types;
 
 public:
-  RawFunctionType(std::shared_ptr<RawType> ret_type,
-                  std::vector<std::shared_ptr<RawType>> param_types)
-      : ret_type(std::move(ret_type)), param_types(std::move(param_types)) {}
+  RawFunctionType(RawType *ret_type, std::vector<RawType *> param_types)
+      : RawType(RawTypeValue::FUNCTION), ret_type(ret_type),
+        param_types(std::move(param_types)) {}
+
+  static bool classof(const RawType *t) {
+    return t->getRawTypeValue() == RawTypeValue::FUNCTION;
+  }
 
   std::string print() override {
     std::stringstream ss;
-    for (const auto &t : param_types) {
-      ss << t->print();
-      if (t != param_types.back())
+    for (std::size_t i = 0; i < param_types.size(); i++) {
+      if (i > 0)
         ss << ", ";
+      ss << param_types[i]->print();
     }
     return "(" + ss.str() + ")->" + ret_type->print();
   }
 
-  RawTypeValue getRawTypeValue() override { return RawTypeValue::FUNCTION; }
-
-  std::vector<std::shared_ptr<RawType>> get_param() override {
-    return param_types;
-  }
+  std::vector<RawType *> get_param() override { return param_types; }
 
-  std::shared_ptr<RawType> get_return() override { return ret_type; }
+  RawType *get_return() override { return ret_type; }
 
-  bool compare_equal(const std::shared_ptr<RawType> &b) override {
+  bool compare_equal(RawType *b) override {
     if (b == nullptr)
       return false;
     switch (b->getRawTypeValue()) {
     case RawTypeValue::FUNCTION: {
-      auto tmp = b->getRawFunctionType()->param_types;
+      auto tmp = cast<RawFunctionType>(b)->param_types;
       if (param_types.size() != tmp.size())
         return false;
       for (size_t i = 0; i < param_types.size(); i++)
         if (!param_types[i]->compare_equal(tmp[i]))
           return false;
-      return ret_type->compare_equal(b->getRawFunctionType()->ret_type);
+      return ret_type->compare_equal(cast<RawFunctionType>(b)->ret_type);
     }
     case RawTypeValue::INT:
     case RawTypeValue::CHAR:
@@ -159,34 +195,12 @@ public:
     }
   }
 
-  bool compare_exact(const std::shared_ptr<RawType> &b) override {
-    if (b == nullptr)
-      return false;
-    switch (b->getRawTypeValue()) {
-    case RawTypeValue::FUNCTION: {
-      auto tmp = b->getRawFunctionType()->param_types;
-      if (param_types.size() != tmp.size())
-        return false;
-      for (size_t i = 0; i < param_types.size(); i++)
-        if (!param_types[i]->compare_exact(tmp[i]))
-          return false;
-      return ret_type->compare_exact(b->getRawFunctionType()->ret_type);
-    }
-    case RawTypeValue::NIL:
-      return true;
-    default:
-      return false;
-    }
-  }
-
-  RawFunctionType *getRawFunctionType() override { return this; }
-
-  llvm::FunctionType *getLLVMFunctionType(llvm::IRBuilder<> builder) override {
+  llvm::Type *buildLLVMType(LLVMTypeCache &types) override {
     std::vector<llvm::Type *> param;
+    param.reserve(param_types.size());
     for (const auto &t : param_types)
-      param.push_back(t->getLLVMType(builder));
-    return llvm::FunctionType::get(ret_type->getLLVMType(builder), param,
-                                   false);
+      param.push_back(t->getLLVMType(types));
+    return llvm::FunctionType::get(ret_type->getLLVMType(types), param, false);
   }
 
   int size() override { return 1; }
@@ -194,11 +208,14 @@ public:
 
 class RawScalarType : public RawType {
   FRIENDS
-  RawTypeValue type_kind;
   int ptr_diff = -1;
 
 public:
-  explicit RawScalarType(RawTypeValue v) : type_kind(v) {}
+  explicit RawScalarType(RawTypeValue v) : RawType(v) {}
+
+  static bool classof(const RawType *t) {
+    return t->getRawTypeValue() <= RawTypeValue::INT;
+  }
 
   std::string print() override {
     switch (type_kind) {
@@ -232,9 +249,7 @@ public:
 
   void setSize(int s) override { ptr_diff = s; }
 
-  RawTypeValue getRawTypeValue() override { return type_kind; }
-
-  bool compare_equal(const std::shared_ptr<RawType> &b) override {
+  bool compare_equal(RawType *b) override {
     if (b == nullptr)
       return false;
     switch (b->getRawTypeValue()) {
@@ -248,54 +263,29 @@ public:
     case RawTypeValue::POINTER:
       if (type_kind == RawTypeValue::VOID)
         return false;
-      return compare_equal(std::make_shared<RawScalarType>(RawTypeValue::INT));
+      return type_kind == RawTypeValue::INT ||
+             type_kind == RawTypeValue::CHAR || type_kind == RawTypeValue::NIL;
     case RawTypeValue::FUNCTION:
-      return compare_equal(b->getRawFunctionType()->get_return());
-    default:
-      return false;
-    }
-  }
-
-  bool compare_exact(const std::shared_ptr<RawType> &b) override {
-    if (b == nullptr)
-      return false;
-    switch (b->getRawTypeValue()) {
-    case RawTypeValue::VOID:
-      return type_kind == RawTypeValue::VOID;
-    case RawTypeValue::NIL:
-    case RawTypeValue::INT:
-      return type_kind == RawTypeValue::INT || type_kind == RawTypeValue::NIL;
-    case RawTypeValue::CHAR:
-      return type_kind == RawTypeValue::CHAR || type_kind == RawTypeValue::NIL;
+      return compare_equal(b->get_return());
     default:
       return false;
     }
   }
 
-  RawScalarType *getRawScalarType() override { return this; }
-
-  llvm::Type *getLLVMType(llvm::IRBuilder<> builder) override {
-    switch (type_kind) {
-    case RawTypeValue::VOID:
-      return builder.getInt8Ty();
-    case RawTypeValue::INT:
-      return builder.getInt32Ty();
-    case RawTypeValue::CHAR:
-      return builder.getInt8Ty();
-    case RawTypeValue::NIL:
-      return builder.getInt8Ty();
-    default:
-      return nullptr;
-    }
-  }
+  llvm::Type *buildLLVMType(LLVMTypeCache &types) override;
 };
 
 class RawPointerType : public RawType {
   FRIENDS
-  std::shared_ptr<RawType> ptr;
+  RawType *ptr;
 
 public:
-  explicit RawPointerType(std::shared_ptr<RawType> ptr) : ptr(std::move(ptr)) {}
+  explicit RawPointerType(RawType *ptr)
+      : RawType(RawTypeValue::POINTER), ptr(ptr) {}
+
+  static bool classof(const RawType *t) {
+    return t->getRawTypeValue() == RawTypeValue::POINTER;
+  }
 
   std::string print() override {
     if (ptr)
@@ -303,15 +293,13 @@ public:
     return "&()";
   }
 
-  RawTypeValue getRawTypeValue() override { return RawTypeValue::POINTER; }
-
   int size() override { return 8; }
 
   int ptr_size() override { return ptr->ptr_size(); }
 
-  std::shared_ptr<RawType> deref() override { return ptr; }
+  RawType *deref() override { return ptr; }
 
-  bool compare_equal(const std::shared_ptr<RawType> &b) override {
+  bool compare_equal(RawType *b) override {
     if (b == nullptr)
       return false;
     switch (b->getRawTypeValue()) {
@@ -334,17 +322,6 @@ public:
     return false;
   }
 
-  bool compare_exact(const std::shared_ptr<RawType> &b) override {
-    switch (b->getRawTypeValue()) {
-    case RawTypeValue::POINTER:
-      return ptr->compare_exact(b->deref());
-    case RawTypeValue::NIL:
-      return true;
-    default:
-      return false;
-    }
-  }
-
   bool isVoidPtr() override {
     if (ptr)
       return ptr->getRawTypeValue() == RawTypeValue::VOID || ptr->isVoidPtr();
@@ -352,7 +329,7 @@ public:
       return false;
   }
 
-  std::shared_ptr<RawType> get_return() override { return ptr->get_return(); }
+  RawType *get_return() override { return ptr->get_return(); }
 
   bool isFunctionPointer() override {
     if (ptr->getRawTypeValue() == RawTypeValue::FUNCTION)
@@ -361,59 +338,247 @@ public:
       return ptr->isFunctionPointer();
   }
 
-  llvm::Type *getLLVMType(llvm::IRBuilder<> builder) override {
-    return llvm::PointerType::getUnqual(ptr->getLLVMType(builder));
+  llvm::Type *buildLLVMType(LLVMTypeCache &types) override {
+    return llvm::PointerType::getUnqual(ptr->getLLVMType(types));
   }
 };
 
+/**
+ * memory layout of a complete struct, members are aligned to their size
+ */
+struct StructLayout {
+  int size = 0;
+  int align = 1;
+  std::vector<int> offsets;
+};
+
+/**
+ * struct identified by its tag, there is no LLVM type for it yet - it keeps
+ * the default buildLLVMType, so getLLVMType yields nullptr
+ */
 class RawStructType : public RawType {
   FRIENDS
   std::string name;
+  // symbol of the struct tag, 0 for structs without a tag
+  unsigned int tag;
+  StructLayout layout;
 
 public:
-  explicit RawStructType(std::string name) : name(std::move(name)) {}
+  explicit RawStructType(std::string name, unsigned int tag = 0)
+      : RawType(RawTypeValue::STRUCT), name(std::move(name)), tag(tag) {}
 
-  std::string print() override { return name; }
+  static bool classof(const RawType *t) {
+    return t->getRawTypeValue() == RawTypeValue::STRUCT;
+  }
 
-  RawTypeValue getRawTypeValue() override { return RawTypeValue::STRUCT; }
+  std::string print() override { return name; }
 
-  bool compare_equal(const std::shared_ptr<RawType> &b) override {
+  bool compare_equal(RawType *b) override {
     if (b == nullptr)
       return false;
     switch (b->getRawTypeValue()) {
     case RawTypeValue::STRUCT:
-      return name == b->getRawStructType()->name ||
-             name + "." == b->getRawStructType()->name ||
-             name == b->getRawStructType()->name + ".";
+      return tag == cast<RawStructType>(b)->tag &&
+             name == cast<RawStructType>(b)->name;
     default:
       return false;
     }
   }
 
-  bool compare_exact(const std::shared_ptr<RawType> &b) override {
-    return compare_equal(b);
+  /**
+   * set the sizes of the (flattened) members once the struct is complete and
+   * compute its layout
+   *
+   * @param elems member sizes
+   */
+  void complete(std::vector<int> elems) {
+    elem_size = std::move(elems);
+    layout = StructLayout();
+    layout.offsets.reserve(elem_size.size());
+    for (int i : elem_size) {
+      if (i > 0 && layout.size % i != 0)
+        layout.size += i - layout.size % i;
+      layout.offsets.push_back(layout.size);
+      layout.size += i;
+      layout.align = std::max(layout.align, i);
+    }
+    if (layout.size % layout.align != 0)
+      layout.size += layout.align - layout.size % layout.align;
   }
 
-  // calculate alignment of struct
-  int size() override {
-    int size = 0;
-    int pad = 1;
-    for (int i : elem_size) {
-      size += i;
-      pad = std::max(pad, i);
-      if (size > 0 && size % i != 0) {
-        size += i - size % i;
-      }
+  const StructLayout &getLayout() const { return layout; }
+
+  int size() override { return layout.size; }
+
+  std::string getName() { return name; }
+
+  unsigned int getTag() const { return tag; }
+};
+
+/**
+ * memoised compare_equal for pairs of pointer, function and struct types,
+ * which are unique inside their TypeContext so that a pair of them always
+ * gives the same result
+ */
+class CompatibilityCache {
+  struct PairHash {
+    std::size_t operator()(const std::pair<RawType *, RawType *> &p) const {
+      return std::hash<RawType *>()(p.first) * 31 +
+             std::hash<RawType *>()(p.second);
     }
-    if (size > 0 && size % pad != 0) {
-      size += pad - size % pad;
+  };
+  std::unordered_map<std::pair<RawType *, RawType *>, bool, PairHash> cache;
+
+public:
+  /**
+   * decide if types are castable into each other
+   *
+   * @param a type
+   * @param b type
+   * @return bool
+   */
+  bool compatible(RawType *a, RawType *b) {
+    // scalar checks are cheaper than the lookup
+    if (b == nullptr || a->getRawTypeValue() < RawTypeValue::POINTER ||
+        b->getRawTypeValue() < RawTypeValue::POINTER)
+      return a->compare_equal(b);
+    auto it = cache.find({a, b});
+    if (it != cache.end())
+      return it->second;
+    auto result = a->compare_equal(b);
+    cache.emplace(std::make_pair(a, b), result);
+    return result;
+  }
+};
+
+/**
+ * LLVM types of the raw types of one TypeContext in one LLVMContext, each
+ * built once and then looked up by the id of the raw type - the memo is kept
+ * here and not in RawType since raw types outlive the contexts they are
+ * lowered into, a new context may get the address of a freed one, and the
+ * codegen shards lower the same raw types in their own contexts at once
+ */
+class LLVMTypeCache {
+  llvm::LLVMContext &ctx;
+  std::vector<llvm::Type *> types;
+
+public:
+  explicit LLVMTypeCache(llvm::LLVMContext &ctx) : ctx(ctx) {}
+
+  llvm::LLVMContext &getContext() { return ctx; }
+
+  /**
+   * @param t raw type
+   * @return LLVM type of t, nullptr if there is none
+   */
+  llvm::Type *get(RawType *t) {
+    if (t->id >= types.size())
+      types.resize(t->id + 1);
+    if (!types[t->id]) {
+      // contained types may grow the table
+      auto type = t->buildLLVMType(*this);
+      types[t->id] = type;
     }
-    return size;
+    return types[t->id];
   }
+};
 
-  RawStructType *getRawStructType() override { return this; }
+inline llvm::Type *RawType::getLLVMType(LLVMTypeCache &types) {
+  return types.get(this);
+}
+
+inline llvm::Type *RawScalarType::buildLLVMType(LLVMTypeCache &types) {
+  switch (type_kind) {
+  case RawTypeValue::INT:
+    return llvm::Type::getInt32Ty(types.getContext());
+  case RawTypeValue::VOID:
+  case RawTypeValue::CHAR:
+  case RawTypeValue::NIL:
+    return llvm::Type::getInt8Ty(types.getContext());
+  default:
+    return nullptr;
+  }
+}
 
-  std::string getName() { return name; }
+/**
+ * owner of all types of a translation unit - scalar, pointer and function
+ * types are interned, so structurally identical types are the same object,
+ * struct types are distinct per definition
+ */
+class TypeContext {
+  RawScalarType nil_type{RawTypeValue::NIL};
+  RawScalarType void_type{RawTypeValue::VOID};
+  RawScalarType char_type{RawTypeValue::CHAR};
+  RawScalarType int_type{RawTypeValue::INT};
+  // 8 byte result of pointer subtraction
+  RawScalarType ptr_diff_type{RawTypeValue::INT};
+  // pointer types by pointee, function types by return and parameter types
+  std::unordered_map<RawType *, std::unique_ptr<RawPointerType>> pointers;
+  std::map<std::vector<RawType *>, std::unique_ptr<RawFunctionType>> functions;
+  std::vector<std::unique_ptr<RawStructType>> structs;
+  // ids of the scalars are fixed, all other types are numbered on creation
+  unsigned int next_id = 5;
+
+public:
+  TypeContext() {
+    ptr_diff_type.setSize(8);
+    void_type.id = 1;
+    char_type.id = 2;
+    int_type.id = 3;
+    ptr_diff_type.id = 4;
+  }
+  TypeContext(const TypeContext &) = delete;
+  TypeContext &operator=(const TypeContext &) = delete;
+
+  RawType *getScalar(RawTypeValue v) {
+    switch (v) {
+    case RawTypeValue::NIL:
+      return &nil_type;
+    case RawTypeValue::VOID:
+      return &void_type;
+    case RawTypeValue::CHAR:
+      return &char_type;
+    default:
+      return &int_type;
+    }
+  }
+
+  RawType *getPtrDiff() { return &ptr_diff_type; }
+
+  RawType *getPointer(RawType *pointee) {
+    auto &t = pointers[pointee];
+    if (!t) {
+      t = make_unique<RawPointerType>(pointee);
+      t->id = next_id++;
+    }
+    return t.get();
+  }
+
+  RawType *getFunction(RawType *ret, const std::vector<RawType *> &params) {
+    std::vector<RawType *> key;
+    key.reserve(params.size() + 1);
+    key.push_back(ret);
+    key.insert(key.end(), params.begin(), params.end());
+    auto &t = functions[key];
+    if (!t) {
+      t = make_unique<RawFunctionType>(ret, params);
+      t->id = next_id++;
+    }
+    return t.get();
+  }
+
+  /**
+   * create a new struct type, never equal to an existing one
+   *
+   * @param name printed name
+   * @param tag symbol of the struct tag
+   * @return type
+   */
+  RawStructType *createStruct(std::string name, unsigned int tag = 0) {
+    structs.push_back(make_unique<RawStructType>(std::move(name), tag));
+    structs.back()->id = next_id++;
+    return structs.back().get();
+  }
 };
 } // namespace ccc
 
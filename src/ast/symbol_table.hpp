@@ -0,0 +1,167 @@
+#ifndef C4_SYMBOL_TABLE_HPP
+#define C4_SYMBOL_TABLE_HPP
+#include "raw_type.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ccc {
+/**
+ * declared entity - identifiers of variables and functions, struct tags are
+ * stored with a "struct " prefix to keep them in their own namespace
+ */
+struct Symbol {
+  std::string name;
+  RawType *type;
+  // function or struct with a body
+  bool defined = false;
+
+  Symbol(std::string name, RawType *type)
+      : name(std::move(name)), type(type) {}
+};
+
+/**
+ * scope stack mapping identifiers to symbols, symbols get a stable id which
+ * stays valid after their scope was closed - id 0 is reserved for "no symbol"
+ */
+class SymbolTable {
+  std::vector<Symbol> symbols;
+  // visible symbols for every identifier with the depth of their scope,
+  // innermost last
+  std::unordered_map<std::string,
+                     std::vector<std::pair<unsigned int, std::size_t>>>
+      bindings;
+  // symbols bound in open scopes and start of every scope in there
+  std::vector<unsigned int> bound;
+  std::vector<std::size_t> scopes;
+  // members of struct definitions, by symbol of the struct tag
+  std::unordered_map<unsigned int,
+                     std::unordered_map<std::string, unsigned int>>
+      members;
+
+public:
+  /**
+   * start with an open global scope
+   */
+  SymbolTable() : scopes({0}) { symbols.emplace_back("", nullptr); }
+
+  void pushScope() { scopes.push_back(bound.size()); }
+
+  /**
+   * close innermost scope, unbinding all of its symbols
+   */
+  void popScope() {
+    for (auto i = bound.size(); i > scopes.back(); i--)
+      bindings[symbols[bound[i - 1]].name].pop_back();
+    bound.resize(scopes.back());
+    scopes.pop_back();
+  }
+
+  /**
+   * close innermost scope, keeping its symbols as members of a struct
+   *
+   * @param tag symbol of the struct tag
+   */
+  void popRecord(unsigned int tag) {
+    auto &record = members[tag];
+    for (auto i = scopes.back(); i < bound.size(); i++)
+      record[symbols[bound[i]].name] = bound[i];
+    popScope();
+  }
+
+  bool isGlobal() const { return scopes.size() == 1; }
+
+  /**
+   * @return ids of the symbols bound in the innermost scope
+   */
+  std::vector<unsigned int> currentScope() const {
+    return std::vector<unsigned int>(
+        bound.begin() + static_cast<std::ptrdiff_t>(scopes.back()),
+        bound.end());
+  }
+
+  /**
+   * create a new symbol without making it visible
+   *
+   * @param name identifier
+   * @param type type of symbol
+   * @return id
+   */
+  unsigned int create(std::string name, RawType *type) {
+    symbols.emplace_back(std::move(name), type);
+    return static_cast<unsigned int>(symbols.size() - 1);
+  }
+
+  /**
+   * make an existing symbol visible in the innermost scope
+   *
+   * @param id symbol
+   */
+  void bind(unsigned int id) {
+    bindings[symbols[id].name].emplace_back(id, scopes.size());
+    bound.push_back(id);
+  }
+
+  /**
+   * create a symbol in the innermost scope, shadowing outer ones
+   *
+   * @param name identifier
+   * @param type type of symbol
+   * @return id
+   */
+  unsigned int declare(std::string name, RawType *type) {
+    auto id = create(std::move(name), type);
+    bind(id);
+    return id;
+  }
+
+  /**
+   * find the innermost visible symbol
+   *
+   * @param name identifier
+   * @return id or 0 if undeclared
+   */
+  unsigned int lookup(const std::string &name) const {
+    auto it = bindings.find(name);
+    if (it == bindings.end() || it->second.empty())
+      return 0;
+    return it->second.back().first;
+  }
+
+  /**
+   * find a symbol declared in the innermost scope
+   *
+   * @param name identifier
+   * @return id or 0 if not declared in this scope
+   */
+  unsigned int lookupLocal(const std::string &name) const {
+    auto it = bindings.find(name);
+    if (it == bindings.end() || it->second.empty() ||
+        it->second.back().second != scopes.size())
+      return 0;
+    return it->second.back().first;
+  }
+
+  /**
+   * find a member of a struct definition
+   *
+   * @param tag symbol of the struct tag
+   * @param name identifier of member
+   * @return id or 0 if not a member
+   */
+  unsigned int lookupMember(unsigned int tag, const std::string &name) const {
+    auto record = members.find(tag);
+    if (record == members.end())
+      return 0;
+    auto it = record->second.find(name);
+    return it == record->second.end() ? 0 : it->second;
+  }
+
+  Symbol &operator[](unsigned int id) { return symbols[id]; }
+
+  std::size_t size() const { return symbols.size(); }
+};
+} // namespace ccc
+
+#endif // C4_SYMBOL_TABLE_HPP
@@ -0,0 +1,146 @@
+#ifndef C4_TRAVERSAL_HPP
+#define C4_TRAVERSAL_HPP
+#include "ast_node.hpp"
+
+namespace ccc {
+/**
+ * iterate over a subtree in pre-order using an explicit stack, so the depth of
+ * the tree is only limited by the heap - parents are returned before their
+ * children, children in source order
+ */
+class PreOrderIterator {
+  ASTNodeRefListType stack;
+  ASTNodeRefListType buffer;
+  ASTNode *current = nullptr;
+  bool skip = false;
+
+public:
+  explicit PreOrderIterator(ASTNode *root) {
+    if (root)
+      stack.push_back(root);
+  }
+
+  /**
+   * advance to the next node
+   *
+   * @return node or nullptr if traversal is finished
+   */
+  ASTNode *next() {
+    // expand children of the last node lazily, allowing to skip them
+    if (current && !skip) {
+      buffer.clear();
+      current->children(buffer);
+      stack.insert(stack.end(), buffer.rbegin(), buffer.rend());
+    }
+    skip = false;
+    if (stack.empty())
+      return current = nullptr;
+    current = stack.back();
+    stack.pop_back();
+    return current;
+  }
+
+  /**
+   * don't descend into the children of the node returned last
+   */
+  void skipChildren() { skip = true; }
+};
+
+/**
+ * iterate over a subtree in post-order using an explicit stack - children are
+ * returned before their parents, children in source order
+ */
+class PostOrderIterator {
+  // node and if its children were already pushed
+  std::vector<std::pair<ASTNode *, bool>> stack;
+  ASTNodeRefListType buffer;
+  // only nodes it accepts have their children returned, all if it is null
+  bool (*expand)(ASTNode *);
+
+public:
+  /**
+   * @param root subtree
+   * @param expand decides which nodes to descend into, the others are
+   * returned like leaves
+   */
+  explicit PostOrderIterator(ASTNode *root,
+                             bool (*expand)(ASTNode *) = nullptr)
+      : expand(expand) {
+    if (root)
+      stack.emplace_back(root, false);
+  }
+
+  /**
+   * start over with another subtree, keeping the memory of the stack
+   *
+   * @param root subtree
+   */
+  void reset(ASTNode *root) {
+    stack.clear();
+    if (root)
+      stack.emplace_back(root, false);
+  }
+
+  /**
+   * advance to the next node
+   *
+   * @return node or nullptr if traversal is finished
+   */
+  ASTNode *next() {
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      if (top.second) {
+        auto node = top.first;
+        stack.pop_back();
+        return node;
+      }
+      top.second = true;
+      if (expand && !expand(top.first))
+        continue;
+      buffer.clear();
+      top.first->children(buffer);
+      for (auto it = buffer.rbegin(); it != buffer.rend(); ++it)
+        stack.emplace_back(*it, false);
+    }
+    return nullptr;
+  }
+};
+
+/**
+ * call f for every node of the subtree in pre-order
+ *
+ * @param root subtree
+ * @param f callback taking ASTNode *
+ */
+template <class F> void preOrder(ASTNode *root, F f) {
+  PreOrderIterator it(root);
+  while (auto node = it.next())
+    f(node);
+}
+
+/**
+ * call f for every node of the subtree in post-order
+ *
+ * @param root subtree
+ * @param f callback taking ASTNode *
+ */
+template <class F> void postOrder(ASTNode *root, F f) {
+  PostOrderIterator it(root);
+  while (auto node = it.next())
+    f(node);
+}
+
+/**
+ * count nodes of a subtree
+ *
+ * @param root subtree
+ * @return number of nodes
+ */
+inline std::size_t countNodes(ASTNode *root) {
+  std::size_t count = 0;
+  preOrder(root, [&count](ASTNode *) { count++; });
+  return count;
+}
+} // namespace ccc
+
+#endif // C4_TRAVERSAL_HPP
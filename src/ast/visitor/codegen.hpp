@@ -3,25 +3,49 @@
 #ifndef C4_CODEGEN_VISITOR_HPP
 #define C4_CODEGEN_VISITOR_HPP
 #include "../ast_node.hpp"
+#include "../traversal.hpp"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/ProfileSummary.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CallingConv.h>
 #include <llvm/IR/Constants.h>
@@ -35,18 +59,66 @@
 #include <llvm/Pass.h>
 #include <llvm/Support/FormattedStream.h>
 #include <llvm/Support/MathExtras.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
 
 #pragma GCC diagnostic pop
 namespace ccc {
+/**
+ * memory manager for programs run just in time, keeps the exit handlers they
+ * register apart from those of the compiler, so they run while the program's
+ * code is still mapped - when main returns or the program calls exit
+ */
+class JITMemoryManager : public llvm::SectionMemoryManager {
+  static std::vector<void (*)()> &handlers() {
+    static std::vector<void (*)()> registered;
+    return registered;
+  }
+
+  static int atexit(void (*handler)()) {
+    handlers().push_back(handler);
+    return 0;
+  }
+
+  [[noreturn]] static void exit(int status) {
+    runExitHandlers();
+    std::exit(status);
+  }
+
+public:
+  /**
+   * call the registered exit handlers in reverse order and forget them
+   */
+  static void runExitHandlers() {
+    while (!handlers().empty()) {
+      auto handler = handlers().back();
+      handlers().pop_back();
+      handler();
+    }
+  }
+
+  uint64_t getSymbolAddress(const std::string &name) override {
+    if (name == "atexit")
+      return reinterpret_cast<uint64_t>(&JITMemoryManager::atexit);
+    if (name == "exit")
+      return reinterpret_cast<uint64_t>(&JITMemoryManager::exit);
+    return SectionMemoryManager::getSymbolAddress(name);
+  }
+};
+
 /**
  * AST visitor class to generate LLVM IR - requires information from  semantical
  * analysis, so only run afterwards
  */
-class CodegenVisitor : public Visitor<void> {
+class CodegenVisitor : public StaticVisitor<CodegenVisitor, void> {
   // constants
   llvm::LLVMContext ctx;
   llvm::Module mod;
   llvm::IRBuilder<> builder, allocBuilder;
+  // LLVM types of the raw types, built once per translation unit
+  LLVMTypeCache llvm_types;
   // current root of function body
   llvm::Function *parent = nullptr;
   // saved in module and dumped with LLVM IR
@@ -54,17 +126,810 @@ class CodegenVisitor : public Visitor<void> {
   // save current break / continue block when entering a loop
   std::vector<llvm::BasicBlock *> breaks;
   std::vector<llvm::BasicBlock *> continues;
-  // use temporay blocks for labeling
+  // blocks of labels in current function, created by the first goto or by
+  // the label itself
   std::unordered_map<std::string, llvm::BasicBlock *> labels;
-  std::unordered_map<std::string, llvm::BasicBlock *> ulabels;
-  // maps for all functions / declarations in file, identified by prefix
-  std::unordered_map<std::string, llvm::Value *> declarations;
-  std::unordered_map<std::string, llvm::Function *> functions;
+  // if code behind a jump was generated because it contains a label
+  bool dead_code = false;
+  // storage of string literals in module, by their text with escapes
+  // replaced
+  std::unordered_map<std::string, llvm::Constant *> strings;
+  /**
+   * scalar local whose address is never taken, kept in SSA values instead of
+   * a stack slot - definitions are followed through replaced phis
+   */
+  struct Register {
+    llvm::Type *type;
+    std::string name;
+    std::unordered_map<llvm::BasicBlock *, llvm::WeakTrackingVH> definitions;
+  };
+  /**
+   * binding of a symbol, indexed by the symbol id semantic analysis gives
+   * every declaration and use - globals and functions are bound once, locals
+   * by their declaration in the function being generated
+   */
+  struct Slot {
+    // function, global variable or stack slot of a local
+    llvm::Value *value = nullptr;
+    // register of a local is registers[reg - 1], 0 if it has none
+    std::size_t reg = 0;
+  };
+  std::vector<Slot> slots;
+  // registers of current function, and locals which need a stack slot
+  std::vector<Register> registers;
+  std::unordered_set<unsigned int> escaping;
+  // the fast register allocator of the unoptimized backend moves every phi
+  // through two stack slots, so with it locals assigned more than once keep a
+  // single stack slot instead - assigned holds the locals assigned so far
+  bool fast_regalloc = false;
+  std::unordered_set<unsigned int> assigned;
+  // blocks whose predecessors are all known, phis created in the others
+  // get their operands once they are sealed
+  std::unordered_set<llvm::BasicBlock *> sealed;
+  std::unordered_map<llvm::BasicBlock *,
+                     std::vector<std::pair<unsigned int, llvm::PHINode *>>>
+      incomplete;
+  // annotations from semantic analysis
+  SemanticTable *table = nullptr;
+  // path of output file, derived from the input name if empty
+  std::string output;
+  // this visitor generates shard of shards, only function definitions with
+  // node ids in [id_begin, id_end) get a body, the others are just declared
+  unsigned int shard = 0;
+  unsigned int shards = 1;
+  std::size_t id_begin = 0;
+  std::size_t id_end = SIZE_MAX;
+  // host to emit native code for, set by setTarget
+  std::unique_ptr<llvm::TargetMachine> machine;
+  // profile-guided optimization - instrumented code counts how often
+  // functions are entered and conditions of ifs and whiles are evaluated and
+  // true, a profile with these counts is read back as branch weights
+  bool instrument = false;
+  // first bytes of a profile, "c4prof01" in little endian
+  static constexpr uint64_t profile_magic = 0x3130666f72703463;
+  std::string profile_path;
+  std::vector<uint64_t> profile;
+  uint64_t profile_layout = 0;
+  // first counter of functions, ifs and whiles by node id, with a checksum of
+  // their order saved in the profile
+  std::unordered_map<unsigned int, unsigned int> counters;
+  uint64_t layout = 0;
+  llvm::GlobalVariable *counter_array = nullptr;
+  /**
+   * what a function definition does to memory visible to its callers,
+   * including the functions it calls
+   */
+  struct Summary {
+    bool reads = false;
+    bool writes = false;
+    // memory is only accessed through pointer parameters
+    bool arguments_only = false;
+    // may be entered again before it returns
+    bool recursive = true;
+    // parameter all memory is accessed through, -1 if there is none
+    int noalias = -1;
+  };
+  // summaries of all function definitions by symbol, found before any code
+  // is generated so calls see the attributes of functions defined later
+  std::unordered_map<unsigned int, Summary> summaries;
   // value pointers for handling of objects, set while traversing the
   // AST recursivly from bottom up
   llvm::Value *rec_val = nullptr;
   llvm::Value *load = nullptr;
 
+  RawType *typeOf(const ASTNode &n) { return table->getType(n); }
+
+  unsigned int symbolOf(const ASTNode &n) { return table->getSymbol(n); }
+
+  /**
+   * @param extension file extension including the dot
+   * @return output path if one was set, otherwise name of the input file in
+   * the working directory with the extension instead of ".c"
+   */
+  std::string outputName(const std::string &extension) {
+    auto of = output;
+    if (of.empty()) {
+      of = filename.substr(0, filename.rfind(".c")) + extension;
+      if (of.find('/'))
+        of = of.substr(of.rfind('/') + 1, of.size());
+    }
+    if (shards == 1)
+      return of;
+    // shards number their files, a.o becomes a.0.o, a.1.o and so on
+    auto dot = of.rfind('.');
+    auto slash = of.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+      dot = of.size();
+    return of.insert(dot, "." + std::to_string(shard));
+  }
+
+  /**
+   * branch to target, following code is unreachable until the builder gets a
+   * new insert point
+   *
+   * @param target block to continue in
+   */
+  void jump(llvm::BasicBlock *target) {
+    if (builder.GetInsertBlock())
+      builder.CreateBr(target);
+    builder.ClearInsertionPoint();
+  }
+
+  /**
+   * generate a statement or declaration, statements which can't be reached
+   * are left out unless they contain a label
+   *
+   * @param n child of a statement
+   */
+  void statement(ASTNode *n) {
+    if (!builder.GetInsertBlock() && isa<Statement>(n) && !isa<Label>(n)) {
+      bool labelled = false;
+      preOrder(n, [&labelled](ASTNode *c) { labelled |= isa<Label>(c); });
+      if (!labelled)
+        return;
+      llvm::BasicBlock *dead =
+          llvm::BasicBlock::Create(ctx, "dead", parent, nullptr);
+      sealBlock(dead);
+      builder.SetInsertPoint(dead);
+      dead_code = true;
+    }
+    n->accept(this);
+  }
+
+  /**
+   * @param m module
+   * @return false after printing the problems if m is broken
+   */
+  static bool verify(llvm::Module &m) {
+    if (!llvm::verifyModule(m, &llvm::errs()))
+      return true;
+    llvm::errs() << "error: invalid LLVM IR generated for "
+                 << m.getModuleIdentifier() << "\n";
+    return false;
+  }
+
+  /**
+   * open an output file, reporting if it can't be written
+   *
+   * @param path file
+   * @param flags text or binary
+   * @return stream, nullptr on error
+   */
+  static std::unique_ptr<llvm::raw_fd_ostream>
+  openOutput(const std::string &path, llvm::sys::fs::OpenFlags flags) {
+    std::error_code EC;
+    auto stream = make_unique<llvm::raw_fd_ostream>(path, EC, flags);
+    if (!EC)
+      return stream;
+    llvm::errs() << "error: can't write " << path << ": " << EC.message()
+                 << "\n";
+    return nullptr;
+  }
+
+  /**
+   * @param n pointer expression
+   * @param params symbols of the parameters of the current function
+   * @return symbol of the pointer parameter n is computed from, 0 if there is
+   * none
+   */
+  unsigned int baseOf(ASTNode *n, const std::vector<unsigned int> &params) {
+    auto b = dyn_cast<Binary>(n);
+    if (b && (b->op_kind == BinaryOpValue::ADD ||
+              b->op_kind == BinaryOpValue::SUBTRACT)) {
+      auto base = baseOf(b->left_operand.get(), params);
+      return base ? base : baseOf(b->right_operand.get(), params);
+    }
+    auto var = dyn_cast<VariableName>(n);
+    if (!var || typeOf(*var)->getRawTypeValue() != RawTypeValue::POINTER ||
+        std::find(params.begin(), params.end(), symbolOf(*var)) ==
+            params.end())
+      return 0;
+    return symbolOf(*var);
+  }
+
+  /**
+   * summarize the memory accesses and calls of every function definition,
+   * then combine the summaries bottom-up over the strongly connected
+   * components of the call graph - calls to functions without a body in this
+   * file or through pointers can do anything
+   *
+   * @param v root of AST
+   */
+  void inferAttributes(TranslationUnit *v) {
+    std::vector<FunctionDefinition *> definitions;
+    std::unordered_map<unsigned int, unsigned int> index;
+    std::unordered_set<unsigned int> globals;
+    for (const auto &e : v->extern_list) {
+      auto f = dyn_cast<FunctionDefinition>(e.get());
+      if (f && !f->isFuncPtr) {
+        index[symbolOf(*f)] = definitions.size();
+        definitions.push_back(f);
+      } else if (isa<DataDeclaration>(e.get()))
+        globals.insert(symbolOf(*e));
+    }
+    // effects of the bodies themselves, with the pointer all memory is
+    // accessed through or UINT_MAX if there are several
+    struct Body {
+      bool reads = false;
+      bool writes = false;
+      bool arguments_only = true;
+      bool opaque = false;
+      unsigned int base = 0;
+      std::vector<unsigned int> params;
+      std::vector<unsigned int> callees;
+    };
+    std::vector<Body> bodies(definitions.size());
+    for (unsigned int i = 0; i < definitions.size(); i++) {
+      auto &body = bodies[i];
+      ASTNode *declarator = nullptr;
+      preOrder(definitions[i]->fn_name.get(), [&declarator](ASTNode *n) {
+        if (!declarator && isa<FunctionDeclarator>(n))
+          declarator = n;
+      });
+      for (const auto &p : cast<FunctionDeclarator>(declarator)->param_list) {
+        auto name = p->param_name ? p->param_name->getIdentifier() : nullptr;
+        body.params.push_back(name ? symbolOf(**name) : 0);
+      }
+      // assignment targets are written, operands of & aren't accessed at all
+      // and parameters which are changed can point anywhere
+      std::unordered_set<ASTNode *> stored, addressed;
+      std::unordered_set<unsigned int> changed, bases;
+      auto access = [&body, &stored, &bases](ASTNode *n, unsigned int base) {
+        body.reads = true;
+        body.writes |= stored.count(n) > 0;
+        bases.insert(base);
+        if (base == 0 || (body.base && body.base != base))
+          body.base = UINT_MAX;
+        else
+          body.base = base;
+      };
+      preOrder(definitions[i]->fn_body.get(), [&](ASTNode *n) {
+        if (auto a = dyn_cast<Assignment>(n))
+          stored.insert(a->left_operand.get());
+        else if (auto c = dyn_cast<FunctionCall>(n)) {
+          auto callee = dyn_cast<VariableName>(c->callee_name.get());
+          if (callee && index.count(symbolOf(*callee)))
+            body.callees.push_back(index[symbolOf(*callee)]);
+          else
+            body.opaque = true;
+        } else if (auto u = dyn_cast<Unary>(n)) {
+          if (u->op_kind == UnaryOpValue::ADDRESS_OF)
+            addressed.insert(u->operand.get());
+          else if (u->op_kind == UnaryOpValue::DEREFERENCE &&
+                   !addressed.count(n))
+            access(n, baseOf(u->operand.get(), body.params));
+        } else if (auto s = dyn_cast<ArraySubscriptOp>(n)) {
+          auto base = baseOf(s->array_name.get(), body.params);
+          if (!addressed.count(n))
+            access(n, base ? base : baseOf(s->index_value.get(), body.params));
+        } else if (auto m = dyn_cast<MemberAccessOp>(n)) {
+          if (!addressed.count(n))
+            access(n, m->op_kind == PostFixOpValue::ARROW
+                          ? baseOf(m->struct_name.get(), body.params)
+                          : 0);
+        } else if (auto var = dyn_cast<VariableName>(n)) {
+          if (stored.count(n) || addressed.count(n))
+            changed.insert(symbolOf(*var));
+          if (globals.count(symbolOf(*var)) && !addressed.count(n))
+            access(n, 0);
+        }
+      });
+      for (auto base : bases)
+        body.arguments_only &= base != 0 && !changed.count(base);
+      if (changed.count(body.base))
+        body.base = UINT_MAX;
+    }
+    // Tarjan's algorithm with an explicit stack, components are completed
+    // after all components they call
+    std::vector<Summary> results(definitions.size());
+    std::vector<bool> unknown(definitions.size());
+    std::vector<unsigned int> order(definitions.size(), UINT_MAX);
+    std::vector<unsigned int> low(definitions.size());
+    std::vector<unsigned int> component(definitions.size(), UINT_MAX);
+    std::vector<unsigned int> stack;
+    std::vector<std::pair<unsigned int, unsigned int>> work;
+    unsigned int visited = 0;
+    for (unsigned int root = 0; root < definitions.size(); root++) {
+      if (order[root] != UINT_MAX)
+        continue;
+      work.emplace_back(root, 0);
+      while (!work.empty()) {
+        unsigned int n = work.back().first;
+        if (order[n] == UINT_MAX) {
+          order[n] = low[n] = visited++;
+          stack.push_back(n);
+        }
+        if (work.back().second < bodies[n].callees.size()) {
+          unsigned int c = bodies[n].callees[work.back().second++];
+          if (order[c] == UINT_MAX)
+            work.emplace_back(c, 0);
+          else if (component[c] == UINT_MAX)
+            low[n] = std::min(low[n], order[c]);
+          continue;
+        }
+        work.pop_back();
+        if (!work.empty())
+          low[work.back().first] = std::min(low[work.back().first], low[n]);
+        if (low[n] != order[n])
+          continue;
+        std::vector<unsigned int> members;
+        do {
+          members.push_back(stack.back());
+          component[stack.back()] = n;
+          stack.pop_back();
+        } while (members.back() != n);
+        Summary summary;
+        bool cycle = members.size() > 1, opaque = false;
+        for (auto m : members) {
+          summary.reads |= bodies[m].reads || bodies[m].opaque;
+          summary.writes |= bodies[m].writes || bodies[m].opaque;
+          opaque |= bodies[m].opaque;
+          for (auto c : bodies[m].callees) {
+            cycle |= component[c] == n;
+            if (component[c] == n)
+              continue;
+            summary.reads |= results[c].reads;
+            summary.writes |= results[c].writes;
+            opaque |= unknown[c];
+          }
+        }
+        // unknown code could call back
+        summary.recursive = cycle || opaque;
+        for (auto m : members) {
+          results[m] = summary;
+          unknown[m] = opaque;
+        }
+        // memory accessed by callees could be reached through anything
+        for (auto m : members) {
+          bool pure = !bodies[m].opaque;
+          for (auto c : bodies[m].callees)
+            pure &= !results[c].reads && !results[c].writes;
+          results[m].arguments_only = pure && bodies[m].arguments_only;
+          auto &params = bodies[m].params;
+          auto param = std::find(params.begin(), params.end(), bodies[m].base);
+          if (pure && bodies[m].base && param != params.end())
+            results[m].noalias = param - params.begin();
+        }
+      }
+    }
+    for (unsigned int i = 0; i < definitions.size(); i++)
+      summaries[symbolOf(*definitions[i])] = results[i];
+  }
+
+  /**
+   * attach the inferred attributes to a function, C code never unwinds
+   *
+   * @param f function
+   * @param symbol symbol of f
+   */
+  void addAttributes(llvm::Function *f, unsigned int symbol) {
+    auto it = summaries.find(symbol);
+    if (it == summaries.end())
+      return;
+    const auto &summary = it->second;
+    f->addFnAttr(llvm::Attribute::NoUnwind);
+    if (!summary.recursive)
+      f->addFnAttr(llvm::Attribute::NoRecurse);
+    // instrumented functions all write their counters
+    if (instrument)
+      return;
+    if (!summary.reads && !summary.writes)
+      f->addFnAttr(llvm::Attribute::ReadNone);
+    else if (!summary.writes)
+      f->addFnAttr(llvm::Attribute::ReadOnly);
+    if (summary.arguments_only && (summary.reads || summary.writes))
+      f->addFnAttr(llvm::Attribute::ArgMemOnly);
+    if (summary.noalias >= 0)
+      f->addParamAttr(summary.noalias, llvm::Attribute::NoAlias);
+  }
+
+  /**
+   * give every function one and every if and while two counters in
+   * pre-order, a profile of another program is dropped
+   *
+   * @param v root of AST
+   */
+  void assignCounters(TranslationUnit *v) {
+    std::string order;
+    unsigned int count = 0;
+    std::vector<unsigned int> entries;
+    preOrder(v, [this, &order, &count, &entries](ASTNode *n) {
+      auto f = dyn_cast<FunctionDefinition>(n);
+      if (!f && !isa<IfElse>(n) && !isa<While>(n))
+        return;
+      counters[n->getId()] = count;
+      if (f) {
+        entries.push_back(count++);
+        order += (*f->fn_name->getIdentifier())->name + "(";
+      } else {
+        count += 2;
+        order += isa<IfElse>(n) ? "?" : "*";
+      }
+    });
+    layout = llvm::MD5Hash(order);
+    if (!profile.empty() &&
+        (profile.size() != count || profile_layout != layout)) {
+      llvm::errs() << "warning: profile " << profile_path << " doesn't match "
+                   << filename << ", ignored\n";
+      profile.clear();
+    }
+    if (!profile.empty())
+      addProfileSummary(entries);
+    auto type = llvm::ArrayType::get(builder.getInt64Ty(), count);
+    counter_array = new llvm::GlobalVariable(
+        mod, type, false, llvm::GlobalValue::ExternalLinkage,
+        llvm::ConstantAggregateZero::get(type),
+        "__c4_profile_counters");
+    counter_array->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+
+  /**
+   * count an execution of the insert point
+   *
+   * @param index counter
+   */
+  void increment(unsigned int index) {
+    llvm::Constant *indices[] = {builder.getInt64(0), builder.getInt64(index)};
+    auto counter = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        counter_array->getValueType(), counter_array, indices);
+    auto value = builder.CreateLoad(counter, "counter");
+    builder.CreateStore(builder.CreateAdd(value, builder.getInt64(1)),
+                        counter);
+  }
+
+  /**
+   * @param index first counter of an if or while, counting evaluations and
+   * true conditions
+   * @return branch weights from the profile, nullptr without profile
+   */
+  llvm::MDNode *weights(unsigned int index) {
+    if (profile.empty())
+      return nullptr;
+    // a goto into the body can make it more frequent than the condition
+    uint64_t taken = profile[index + 1];
+    uint64_t total = std::max(profile[index], taken);
+    // weights only have 32 bit
+    uint64_t scale = total / UINT32_MAX + 1;
+    return llvm::MDBuilder(ctx).createBranchWeights(
+        static_cast<uint32_t>(taken / scale),
+        static_cast<uint32_t>((total - taken) / scale));
+  }
+
+  /**
+   * add the runtime of instrumented code, a function registered with atexit
+   * writes a magic number, the checksum of the counter order and the
+   * counters to the profile
+   */
+  void emitProfileRuntime() {
+    auto ptr = builder.getInt8PtrTy();
+    auto size = builder.getInt64Ty();
+    auto dump = llvm::Function::Create(
+        llvm::FunctionType::get(builder.getVoidTy(), false),
+        llvm::GlobalValue::ExternalLinkage, "__c4_profile_dump", &mod);
+    dump->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    auto entry = llvm::BasicBlock::Create(ctx, "entry", dump);
+    auto write = llvm::BasicBlock::Create(ctx, "write", dump);
+    auto done = llvm::BasicBlock::Create(ctx, "done", dump);
+    builder.SetInsertPoint(entry);
+    auto file = builder.CreateCall(
+        mod.getOrInsertFunction("fopen", ptr, ptr, ptr),
+        {builder.CreateGlobalStringPtr(profile_path),
+         builder.CreateGlobalStringPtr("wb")},
+        "file");
+    builder.CreateCondBr(builder.CreateIsNull(file), done, write);
+    builder.SetInsertPoint(write);
+    uint64_t header[] = {profile_magic, layout};
+    auto data = llvm::ConstantDataArray::get(ctx, header);
+    auto global = new llvm::GlobalVariable(mod, data->getType(), true,
+                                           llvm::GlobalValue::PrivateLinkage,
+                                           data, "profile.header");
+    auto fwrite = mod.getOrInsertFunction("fwrite", size, ptr, size, size, ptr);
+    builder.CreateCall(fwrite, {builder.CreateBitCast(global, ptr),
+                                builder.getInt64(8), builder.getInt64(2),
+                                file});
+    builder.CreateCall(
+        fwrite, {builder.CreateBitCast(counter_array, ptr), builder.getInt64(8),
+                 builder.getInt64(counter_array->getValueType()
+                                      ->getArrayNumElements()),
+                 file});
+    builder.CreateCall(
+        mod.getOrInsertFunction("fclose", builder.getInt32Ty(), ptr), {file});
+    builder.CreateBr(done);
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    auto init = llvm::Function::Create(
+        llvm::FunctionType::get(builder.getVoidTy(), false),
+        llvm::GlobalValue::InternalLinkage, "__c4_profile_init", &mod);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", init));
+    builder.CreateCall(
+        mod.getOrInsertFunction("atexit", builder.getInt32Ty(),
+                                dump->getType()),
+        {dump});
+    builder.CreateRetVoid();
+    llvm::appendToGlobalCtors(mod, init, 0);
+  }
+
+  /**
+   * describe the distribution of the counts in the profile like LLVM's
+   * instrumentation does, so the optimizer knows which code is hot
+   *
+   * @param entries counters of function entries
+   */
+  void addProfileSummary(const std::vector<unsigned int> &entries) {
+    uint64_t total = 0;
+    uint64_t max = 0;
+    uint64_t max_function = 0;
+    for (auto c : profile) {
+      total += c;
+      max = std::max(max, c);
+    }
+    for (auto i : entries)
+      max_function = std::max(max_function, profile[i]);
+    // inner counts are those which don't count function entries
+    std::vector<bool> entry(profile.size());
+    for (auto i : entries)
+      entry[i] = true;
+    uint64_t max_internal = 0;
+    for (std::size_t i = 0; i < profile.size(); i++)
+      if (!entry[i])
+        max_internal = std::max(max_internal, profile[i]);
+    // minimal count of the hottest counters making up each share of the
+    // total, counters with equal counts are taken together
+    static const uint32_t cutoffs[] = {
+        10000,  100000, 200000, 300000, 400000, 500000, 600000, 700000,
+        800000, 900000, 950000, 990000, 999000, 999900, 999990, 999999};
+    std::vector<uint64_t> counts(profile);
+    std::sort(counts.begin(), counts.end(), std::greater<uint64_t>());
+    llvm::SummaryEntryVector detailed;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    std::size_t seen = 0;
+    for (auto cutoff : cutoffs) {
+      // total * cutoff / 1000000 without overflow
+      uint64_t desired =
+          total / 1000000 * cutoff + total % 1000000 * cutoff / 1000000;
+      while (sum < desired && seen < counts.size()) {
+        min = counts[seen];
+        for (; seen < counts.size() && counts[seen] == min; seen++)
+          sum += min;
+      }
+      detailed.emplace_back(cutoff, min, seen);
+    }
+    llvm::ProfileSummary summary(
+        llvm::ProfileSummary::PSK_Instr, detailed, total, max, max_internal,
+        max_function, static_cast<uint32_t>(profile.size()),
+        static_cast<uint32_t>(entries.size()));
+    mod.setProfileSummary(summary.getMD(ctx));
+  }
+
+  /**
+   * SSA construction after Braun et al., "Simple and Efficient Construction
+   * of Static Single Assignment Form"
+   *
+   * @param var symbol of register
+   * @param block block of the definition
+   * @param value new value
+   */
+  void writeVariable(unsigned int var, llvm::BasicBlock *block,
+                     llvm::Value *value) {
+    registers[slots[var].reg - 1].definitions[block] = value;
+  }
+
+  /**
+   * @param var symbol of register
+   * @param block block of the use
+   * @return value of register at the end of block
+   */
+  llvm::Value *readVariable(unsigned int var, llvm::BasicBlock *block) {
+    auto &reg = registers[slots[var].reg - 1];
+    auto it = reg.definitions.find(block);
+    if (it != reg.definitions.end() && it->second)
+      return it->second;
+    llvm::Value *value;
+    if (!sealed.count(block)) {
+      auto phi = createPhi(reg, block);
+      incomplete[block].emplace_back(var, phi);
+      value = phi;
+    } else if (llvm::pred_empty(block))
+      // unreachable or uninitialized
+      value = llvm::UndefValue::get(reg.type);
+    else if (auto pred = block->getSinglePredecessor())
+      value = readVariable(var, pred);
+    else {
+      auto phi = createPhi(reg, block);
+      // break cycles through this block
+      writeVariable(var, block, phi);
+      value = addPhiOperands(var, phi);
+    }
+    writeVariable(var, block, value);
+    return value;
+  }
+
+  /**
+   * @param reg register
+   * @param block block to put phi in front of
+   * @return phi without operands
+   */
+  llvm::PHINode *createPhi(const Register &reg, llvm::BasicBlock *block) {
+    if (block->empty())
+      return llvm::PHINode::Create(reg.type, 2, reg.name, block);
+    return llvm::PHINode::Create(reg.type, 2, reg.name, &block->front());
+  }
+
+  /**
+   * @param var symbol of register
+   * @param phi phi of register without operands
+   * @return phi or the value replacing it if it was trivial
+   */
+  llvm::Value *addPhiOperands(unsigned int var, llvm::PHINode *phi) {
+    for (auto pred : llvm::predecessors(phi->getParent()))
+      phi->addIncoming(readVariable(var, pred), pred);
+    return tryRemoveTrivialPhi(phi);
+  }
+
+  /**
+   * remove phi which only merges one value besides itself
+   *
+   * @param phi phi with all operands
+   * @return phi or the value replacing it
+   */
+  llvm::Value *tryRemoveTrivialPhi(llvm::PHINode *phi) {
+    llvm::Value *same = nullptr;
+    for (auto &op : phi->incoming_values()) {
+      if (op == same || op == phi)
+        continue;
+      if (same)
+        return phi;
+      same = op;
+    }
+    if (!same)
+      same = llvm::UndefValue::get(phi->getType());
+    // a phi uses this one once per edge, and the removal of one user can
+    // replace or erase another - handles follow the replacements
+    std::vector<llvm::WeakTrackingVH> users;
+    std::unordered_set<llvm::User *> seen;
+    for (auto user : phi->users())
+      if (user != phi && llvm::isa<llvm::PHINode>(user) &&
+          seen.insert(user).second)
+        users.emplace_back(user);
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    // phis using this one might have become trivial, unless they still wait
+    // for operands of some predecessors
+    for (auto &user : users) {
+      auto next = llvm::dyn_cast_or_null<llvm::PHINode>(user);
+      if (next && next->getNumIncomingValues() ==
+                      static_cast<unsigned int>(
+                          llvm::pred_size(next->getParent())))
+        tryRemoveTrivialPhi(next);
+    }
+    return same;
+  }
+
+  /**
+   * mark all predecessors of block as known and complete its phis
+   *
+   * @param block block
+   */
+  void sealBlock(llvm::BasicBlock *block) {
+    auto it = incomplete.find(block);
+    if (it != incomplete.end()) {
+      auto phis = std::move(it->second);
+      incomplete.erase(it);
+      for (const auto &p : phis)
+        addPhiOperands(p.first, p.second);
+    }
+    sealed.insert(block);
+  }
+
+  /**
+   * @param v declaration of a local
+   * @return if the local can be kept in a register
+   */
+  bool promotable(const ASTNode &v) {
+    auto kind = typeOf(v)->getRawTypeValue();
+    return (kind == RawTypeValue::INT || kind == RawTypeValue::CHAR ||
+            kind == RawTypeValue::POINTER) &&
+           !escaping.count(symbolOf(v));
+  }
+
+  /**
+   * let every string literal which is the suffix of another one point into
+   * its storage
+   */
+  void poolStrings() {
+    strings.clear();
+    std::vector<std::pair<std::string, llvm::GlobalVariable *>> pool;
+    for (auto &g : mod.globals()) {
+      if (!g.hasPrivateLinkage() || !g.hasGlobalUnnamedAddr() ||
+          !g.isConstant() || !g.hasInitializer())
+        continue;
+      auto data = llvm::dyn_cast<llvm::ConstantDataArray>(g.getInitializer());
+      if (data && data->isCString()) {
+        auto text = data->getAsCString().str();
+        pool.emplace_back(std::string(text.rbegin(), text.rend()), &g);
+      }
+    }
+    // reversed suffixes are sorted in front of the longer strings ending
+    // with them, so every string can share the storage of its successor -
+    // equal texts keep their order in the module, so the same one survives
+    // in every run
+    std::stable_sort(
+        pool.begin(), pool.end(),
+        [](const std::pair<std::string, llvm::GlobalVariable *> &a,
+           const std::pair<std::string, llvm::GlobalVariable *> &b) {
+          return a.first < b.first;
+        });
+    for (auto i = pool.size(); i > 1; i--) {
+      auto &host = pool[i - 1];
+      auto &guest = pool[i - 2];
+      if (host.first.compare(0, guest.first.size(), guest.first) != 0)
+        continue;
+      llvm::Constant *indices[] = {
+          builder.getInt64(0),
+          builder.getInt64(host.first.size() - guest.first.size())};
+      auto suffix = llvm::ConstantExpr::getInBoundsGetElementPtr(
+          host.second->getValueType(), host.second, indices);
+      guest.second->replaceAllUsesWith(
+          llvm::ConstantExpr::getPointerCast(suffix, guest.second->getType()));
+      guest.second->eraseFromParent();
+      guest.second = host.second;
+      guest.first = host.first;
+    }
+  }
+
+  /**
+   * @param n expression
+   * @param value result of expression
+   * @return i1 if value is nonzero or not null
+   */
+  llvm::Value *truth(const ASTNode &n, llvm::Value *value) {
+    if (typeOf(n)->getRawTypeValue() == RawTypeValue::POINTER)
+      return builder.CreateIsNotNull(value, "notnull");
+    value = builder.CreateZExtOrBitCast(value, builder.getInt32Ty(), "zext");
+    return builder.CreateICmpNE(value, builder.getInt32(0), "cmp");
+  }
+
+  /**
+   * @param n branch of ternary
+   * @param type result type of ternary
+   * @return value of branch converted to type
+   */
+  llvm::Value *branchValue(Expression &n, llvm::Type *type) {
+    if (typeOf(n)->getRawTypeValue() == RawTypeValue::NIL)
+      return llvm::Constant::getNullValue(type);
+    n.accept(this);
+    return builder.CreateZExtOrTrunc(rec_val, type);
+  }
+
+  /**
+   * @param e expression
+   * @param depth number of nested operators to accept
+   * @return if e can be evaluated unconditionally - it has no side effects,
+   * can't trap and only takes a few instructions
+   */
+  bool cheap(Expression *e, int depth = 2) {
+    if (isa<Number>(e) || isa<Character>(e))
+      return true;
+    if (auto var = dyn_cast<VariableName>(e)) {
+      auto value = slots[symbolOf(*var)].value;
+      return !value || !llvm::isa<llvm::Function>(value);
+    }
+    if (depth == 0)
+      return false;
+    if (auto u = dyn_cast<Unary>(e))
+      return (u->op_kind == UnaryOpValue::MINUS ||
+              u->op_kind == UnaryOpValue::NOT) &&
+             cheap(u->operand.get(), depth - 1);
+    if (auto b = dyn_cast<Binary>(e))
+      return b->op_kind != BinaryOpValue::LOGICAL_AND &&
+             b->op_kind != BinaryOpValue::LOGICAL_OR &&
+             b->op_kind != BinaryOpValue::ASSIGN &&
+             cheap(b->left_operand.get(), depth - 1) &&
+             cheap(b->right_operand.get(), depth - 1);
+    return false;
+  }
+
 public:
   /**
    * pass filename to constructor
@@ -72,29 +937,242 @@ public:
    * @param f filename
    */
   explicit CodegenVisitor(std::string f)
-      : mod(f, ctx), builder(ctx), allocBuilder(ctx), filename(std::move(f)){};
-  ~CodegenVisitor() override = default;
+      : mod(f, ctx), builder(ctx), allocBuilder(ctx), llvm_types(ctx),
+        filename(std::move(f)){};
+  ~CodegenVisitor() = default;
 
   /**
    * enable external dumping of module to cerr
    */
   void dump() { mod.dump(); }
 
+  /**
+   * run the standard LLVM pipeline of an optimization level on the module
+   *
+   * @param level 0 to 3 like -O0 to -O3
+   * @param size 1 for -Os, 2 for -Oz
+   * @return false if the module doesn't verify, it is left as it is
+   */
+  bool optimize(unsigned int level, unsigned int size = 0) {
+    if (!verify(mod))
+      return false;
+    llvm::PassManagerBuilder pmb;
+    pmb.OptLevel = level;
+    pmb.SizeLevel = size;
+    if (level > 1)
+      pmb.Inliner = llvm::createFunctionInliningPass(level, size, false);
+    llvm::legacy::FunctionPassManager fpm(&mod);
+    llvm::legacy::PassManager mpm;
+    pmb.populateFunctionPassManager(fpm);
+    pmb.populateModulePassManager(mpm);
+    fpm.doInitialization();
+    for (auto &f : mod)
+      fpm.run(f);
+    fpm.doFinalization();
+    mpm.run(mod);
+    return true;
+  }
+
+  /**
+   * cheapest useful pipeline for short compile times, only promotes the
+   * allocas to registers and cleans up the control flow
+   */
+  void optimizeCompileTime() {
+    llvm::legacy::FunctionPassManager fpm(&mod);
+    fpm.add(llvm::createPromoteMemoryToRegisterPass());
+    fpm.add(llvm::createCFGSimplificationPass());
+    fpm.doInitialization();
+    for (auto &f : mod)
+      fpm.run(f);
+    fpm.doFinalization();
+  }
+
   /**
    * dump LLVM IR of generated module in file
+   *
+   * @param verified run the verifier on the module first
+   * @return false if the module is broken or the file can't be written
    */
-  void compile() {
-    for (const auto &p : ulabels) {
-      builder.SetInsertPoint(p.second);
-      builder.CreateBr(labels[p.first]);
+  bool compile(bool verified = true) {
+    if (verified && !verify(mod))
+      return false;
+    auto stream =
+        openOutput(outputName(".ll"), llvm::sys::fs::OpenFlags::F_Text);
+    if (!stream)
+      return false;
+    mod.print(*stream, nullptr);
+    return true;
+  }
+
+  /**
+   * dump LLVM bitcode of generated module in file, faster to write and to
+   * read for other tools than the textual IR
+   *
+   * @return false if the file can't be written
+   */
+  bool emitBitcode() {
+    auto stream =
+        openOutput(outputName(".bc"), llvm::sys::fs::OpenFlags::F_None);
+    if (!stream)
+      return false;
+    llvm::WriteBitcodeToFile(mod, *stream);
+    return true;
+  }
+
+  /**
+   * compile the module just in time and call its main function in this
+   * process, external functions are resolved against the running program -
+   * static constructors run before main and exit handlers when it returns or
+   * the program calls exit, which then ends this process as well
+   *
+   * @return exit code of main, or -1 if there is no main or no JIT for the
+   * host
+   */
+  int run() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    std::string error;
+    std::unique_ptr<llvm::ExecutionEngine> engine(
+        llvm::EngineBuilder(llvm::CloneModule(mod))
+            .setEngineKind(llvm::EngineKind::JIT)
+            .setMCJITMemoryManager(make_unique<JITMemoryManager>())
+            .setOptLevel(machine ? machine->getOptLevel()
+                                 : llvm::CodeGenOpt::Default)
+            .setErrorStr(&error)
+            .create());
+    if (!engine) {
+      llvm::errs() << error << "\n";
+      return -1;
     }
-    llvm::verifyModule(mod);
-    std::error_code EC;
-    auto of = filename.substr(0, filename.rfind(".c")) + ".ll";
-    if (of.find('/'))
-      of = of.substr(of.rfind('/') + 1, of.size());
-    llvm::raw_fd_ostream stream(of, EC, llvm::sys::fs::OpenFlags::F_Text);
-    mod.print(stream, nullptr);
+    auto main = engine->FindFunctionNamed("main");
+    if (!main) {
+      llvm::errs() << "no main function\n";
+      return -1;
+    }
+    engine->finalizeObject();
+    engine->runStaticConstructorsDestructors(false);
+    auto result = engine->runFunctionAsMain(main, {filename}, environ);
+    JITMemoryManager::runExitHandlers();
+    engine->runStaticConstructorsDestructors(true);
+    return result;
+  }
+
+  /**
+   * write all output to this path instead of deriving it from the input
+   *
+   * @param path output file
+   */
+  void setOutput(std::string path) { output = std::move(path); }
+
+  /**
+   * generate only a part of the function bodies, the shards of a translation
+   * unit are generated by separate visitors - each in its own context, so
+   * they can run on different threads - and written to numbered files which
+   * link like a single one, every shard declares the functions defined by
+   * the others and all of them define the globals as common symbols
+   *
+   * @param index shard of this visitor
+   * @param count number of shards, the function definitions are split by
+   * node id, roughly by size
+   */
+  void setShard(unsigned int index, unsigned int count) {
+    shard = index;
+    shards = std::max(count, 1u);
+  }
+
+  /**
+   * count how often functions are entered and conditions are true, the
+   * compiled program writes the counts to a profile when it exits
+   *
+   * @param path profile, relative to the working directory of the program
+   */
+  void setProfileGenerate(std::string path) {
+    instrument = true;
+    profile_path = std::move(path);
+  }
+
+  /**
+   * attach the counts of a profile as entry counts and branch weights, it is
+   * ignored if it was written by another program
+   *
+   * @param path profile written by an instrumented build
+   * @return false if the file can't be read or is no profile
+   */
+  bool setProfileUse(std::string path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+      return false;
+    auto data = buffer.get()->getBuffer();
+    uint64_t header[2];
+    if (data.size() < sizeof(header) || data.size() % sizeof(uint64_t) != 0)
+      return false;
+    std::memcpy(header, data.data(), sizeof(header));
+    if (header[0] != profile_magic)
+      return false;
+    profile_layout = header[1];
+    profile.resize(data.size() / sizeof(uint64_t) - 2);
+    std::memcpy(profile.data(), data.data() + sizeof(header),
+                profile.size() * sizeof(uint64_t));
+    profile_path = std::move(path);
+    return true;
+  }
+
+  /**
+   * set up native code generation for the host, also used by run - call
+   * before the module is generated, level 0 keeps locals assigned more than
+   * once in stack slots, and before it gets optimized so the passes know its
+   * data layout
+   *
+   * @param level optimization level of the backend, 0 to 3
+   * @param fast select instructions with FastISel
+   * @return false if the host isn't a supported target
+   */
+  bool setTarget(unsigned int level, bool fast = false) {
+    static const llvm::CodeGenOpt::Level levels[] = {
+        llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less,
+        llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive};
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    auto triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+      llvm::errs() << error << "\n";
+      return false;
+    }
+    machine.reset(target->createTargetMachine(
+        triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_,
+        llvm::None, levels[std::min(level, 3u)]));
+    if (fast)
+      machine->setFastISel(true);
+    // the cheap pipeline promotes all stack slots again
+    fast_regalloc = level == 0 && !fast;
+    mod.setTargetTriple(triple);
+    mod.setDataLayout(machine->createDataLayout());
+    return true;
+  }
+
+  /**
+   * write native code of the module in a file, needs setTarget first
+   *
+   * @param type object file or assembly
+   * @return false if the target can't emit this file type or the file can't
+   * be written
+   */
+  bool emit(llvm::TargetMachine::CodeGenFileType type) {
+    auto stream = openOutput(
+        outputName(type == llvm::TargetMachine::CGFT_AssemblyFile ? ".s"
+                                                                  : ".o"),
+        llvm::sys::fs::OpenFlags::F_None);
+    if (!stream)
+      return false;
+    llvm::legacy::PassManager pm;
+    if (machine->addPassesToEmitFile(pm, *stream, nullptr, type)) {
+      llvm::errs() << "target can't emit this file type\n";
+      return false;
+    }
+    pm.run(mod);
+    return true;
   }
 
   /**
@@ -102,33 +1180,78 @@ public:
    *
    * @param v visitor
    */
-  void visitTranslationUnit(TranslationUnit *v) override {
+  void visitTranslationUnit(TranslationUnit *v) {
+    table = &v->table;
+    slots.resize(table->symbolCount());
+    id_begin = table->size() * shard / shards;
+    id_end = table->size() * (shard + 1) / shards;
+    inferAttributes(v);
+    if (instrument || !profile.empty())
+      assignCounters(v);
     for (const auto &e : v->extern_list)
       e->accept(this);
+    if (instrument)
+      emitProfileRuntime();
+    poolStrings();
   }
 
   /**
-   * define a global function, which can be accessed through the functions map
+   * define a global function, which can be accessed through its slot
    *
    * @param v visitor
    */
-  void visitFunctionDefinition(FunctionDefinition *v) override {
+  void visitFunctionDefinition(FunctionDefinition *v) {
     if (!v->isFuncPtr) {
-      if (functions.find(v->getUIdentifier()) != functions.end())
-        parent = functions[v->getUIdentifier()];
+      auto &slot = slots[symbolOf(*v)];
+      if (slot.value)
+        parent = llvm::cast<llvm::Function>(slot.value);
       else {
         parent =
-            llvm::Function::Create(v->getUType()->getLLVMFunctionType(builder),
+            llvm::Function::Create(typeOf(*v)->getLLVMFunctionType(llvm_types),
                                    llvm::GlobalValue::ExternalLinkage,
                                    (*v->fn_name->getIdentifier())->name, &mod);
-        functions[v->getUIdentifier()] = parent;
+        addAttributes(parent, symbolOf(*v));
+        slot.value = parent;
       }
+      // body belongs to another shard
+      if (v->getId() < id_begin || v->getId() >= id_end)
+        return;
+      registers.clear();
+      escaping.clear();
+      assigned.clear();
+      sealed.clear();
+      incomplete.clear();
+      dead_code = false;
+      // locals whose address is taken need a stack slot, for the fast
+      // register allocator also the ones assigned more than once
+      preOrder(v->fn_body.get(), [this](ASTNode *n) {
+        auto u = dyn_cast<Unary>(n);
+        if (u && u->op_kind == UnaryOpValue::ADDRESS_OF &&
+            isa<VariableName>(u->operand))
+          escaping.insert(symbolOf(*u->operand));
+        auto a = dyn_cast<Assignment>(n);
+        if (fast_regalloc && a && isa<VariableName>(a->left_operand) &&
+            !assigned.insert(symbolOf(*a->left_operand)).second)
+          escaping.insert(symbolOf(*a->left_operand));
+      });
       v->fn_name->accept(this);
+      if (instrument)
+        increment(counters[v->getId()]);
+      if (!profile.empty())
+        parent->setEntryCount(profile[counters[v->getId()]]);
       v->fn_body->accept(this);
-      if (builder.GetInsertBlock()->getTerminator() == nullptr) {
+      if (builder.GetInsertBlock()) {
         llvm::Type *CurFuncReturnType = builder.getCurrentFunctionReturnType();
         builder.CreateRet(llvm::Constant::getNullValue(CurFuncReturnType));
       }
+      // labels can be reached by gotos from anywhere in the function, so
+      // their blocks are sealed last
+      labels.clear();
+      for (auto &b : *parent)
+        if (!sealed.count(&b))
+          sealBlock(&b);
+      if (dead_code)
+        llvm::removeUnreachableBlocks(*parent);
     }
   }
 
@@ -137,12 +1260,14 @@ public:
    *
    * @param v visitor
    */
-  void visitFunctionDeclaration(FunctionDeclaration *v) override {
+  void visitFunctionDeclaration(FunctionDeclaration *v) {
     if (!v->isFuncPtr) {
-      functions[v->getUIdentifier()] =
-          llvm::Function::Create(v->getUType()->getLLVMFunctionType(builder),
+      auto f =
+          llvm::Function::Create(typeOf(*v)->getLLVMFunctionType(llvm_types),
                                  llvm::GlobalValue::ExternalLinkage,
                                  (*v->fn_name->getIdentifier())->name, &mod);
+      addAttributes(f, symbolOf(*v));
+      slots[symbolOf(*v)].value = f;
     }
   }
 
@@ -151,21 +1276,26 @@ public:
    *
    * @param v visitor
    */
-  void visitDataDeclaration(DataDeclaration *v) override {
-    if (!v->global) {
+  void visitDataDeclaration(DataDeclaration *v) {
+    if (!v->global && promotable(*v)) {
+      registers.push_back(Register{typeOf(*v)->getLLVMType(llvm_types),
+                                   (*v->data_name->getIdentifier())->name,
+                                   {}});
+      slots[symbolOf(*v)] = Slot{nullptr, registers.size()};
+    } else if (!v->global) {
       allocBuilder.SetInsertPoint(allocBuilder.GetInsertBlock(),
                                   allocBuilder.GetInsertBlock()->begin());
       llvm::Value *dec =
-          allocBuilder.CreateAlloca(v->getUType()->getLLVMType(builder));
+          allocBuilder.CreateAlloca(typeOf(*v)->getLLVMType(llvm_types));
       dec->setName((*v->data_name->getIdentifier())->name);
-      declarations[v->getUIdentifier()] = dec;
-    } else if (declarations.find(v->getUIdentifier()) == declarations.end()) {
+      slots[symbolOf(*v)] = Slot{dec, 0};
+    } else if (!slots[symbolOf(*v)].value) {
       llvm::GlobalVariable *dec = new llvm::GlobalVariable(
-          mod, v->getUType()->getLLVMType(builder), false,
+          mod, typeOf(*v)->getLLVMType(llvm_types), false,
           llvm::GlobalValue::CommonLinkage,
-          llvm::Constant::getNullValue(v->getUType()->getLLVMType(builder)),
+          llvm::Constant::getNullValue(typeOf(*v)->getLLVMType(llvm_types)),
           (*v->data_name->getIdentifier())->name);
-      declarations[v->getUIdentifier()] = dec;
+      slots[symbolOf(*v)].value = dec;
     }
   }
 
@@ -173,19 +1303,19 @@ public:
    *
    * @param v visitor
    */
-  void visitStructDeclaration(StructDeclaration *v) override {
+  void visitStructDeclaration(StructDeclaration *v) {
     (void)v; // TODO WIP
   }
 
-  void visitParamDeclaration(ParamDeclaration *) override {
+  void visitParamDeclaration(ParamDeclaration *) {
     // EMPTY
   }
 
-  void visitScalarType(ScalarType *) override {
+  void visitScalarType(ScalarType *) {
     // EMPTY
   }
 
-  void visitAbstractType(AbstractType *) override {
+  void visitAbstractType(AbstractType *) {
     // EMPTY
   }
 
@@ -193,19 +1323,19 @@ public:
    *
    * @param v visitor
    */
-  void visitStructType(StructType *v) override {
+  void visitStructType(StructType *v) {
     (void)v; // TODO WIP
   }
 
-  void visitDirectDeclarator(DirectDeclarator *) override {
+  void visitDirectDeclarator(DirectDeclarator *) {
     // EMPTY
   }
 
-  void visitAbstractDeclarator(AbstractDeclarator *) override {
+  void visitAbstractDeclarator(AbstractDeclarator *) {
     // EMPTY
   }
 
-  void visitPointerDeclarator(PointerDeclarator *) override {
+  void visitPointerDeclarator(PointerDeclarator *) {
     // EMPTY
   }
 
@@ -214,21 +1344,31 @@ public:
    *
    * @param v visitor
    */
-  void visitFunctionDeclarator(FunctionDeclarator *v) override {
+  void visitFunctionDeclarator(FunctionDeclarator *v) {
     llvm::BasicBlock *FuncMaxEntryBB =
         llvm::BasicBlock::Create(ctx, "entry", parent, nullptr);
     builder.SetInsertPoint(FuncMaxEntryBB);
     allocBuilder.SetInsertPoint(FuncMaxEntryBB);
+    sealBlock(FuncMaxEntryBB);
     int i = 0;
     for (auto &a : parent->args()) {
       a.setName((*v->param_list[i]->param_name->getIdentifier())->name);
+      auto param = symbolOf(**v->param_list[i]->param_name->getIdentifier());
+      // the argument is a definition as well
+      if (!escaping.count(param) &&
+          (!fast_regalloc || !assigned.count(param))) {
+        registers.push_back(Register{a.getType(), a.getName().str(), {}});
+        slots[param] = Slot{nullptr, registers.size()};
+        writeVariable(param, FuncMaxEntryBB, &a);
+        i++;
+        continue;
+      }
       allocBuilder.SetInsertPoint(allocBuilder.GetInsertBlock(),
                                   allocBuilder.GetInsertBlock()->begin());
       llvm::Value *ArgVarAPtr = allocBuilder.CreateAlloca(a.getType());
       ArgVarAPtr->setName(a.getName());
       builder.CreateStore(&a, ArgVarAPtr);
-      declarations[(*v->param_list[i]->param_name->getIdentifier())
-                       ->getUIdentifier()] = ArgVarAPtr;
+      slots[param] = Slot{ArgVarAPtr, 0};
       i++;
     };
   }
@@ -238,9 +1378,9 @@ public:
    *
    * @param v visitor
    */
-  void visitCompoundStmt(CompoundStmt *v) override {
+  void visitCompoundStmt(CompoundStmt *v) {
     for (const auto &s : v->block_items)
-      s->accept(this);
+      statement(s.get());
   }
 
   /**
@@ -248,33 +1388,46 @@ public:
    *
    * @param v visitor
    */
-  void visitIfElse(IfElse *v) override {
-    llvm::BasicBlock *IfHeaderBlock =
-        llvm::BasicBlock::Create(ctx, "if.header", parent, nullptr);
+  void visitIfElse(IfElse *v) {
     llvm::BasicBlock *IfConsequenceBlock =
         llvm::BasicBlock::Create(ctx, "if.consequence", parent, nullptr);
     llvm::BasicBlock *IfAlternativeBlock =
-        llvm::BasicBlock::Create(ctx, "if.alternative", parent, nullptr);
+        v->elseStmt
+            ? llvm::BasicBlock::Create(ctx, "if.alternative", parent, nullptr)
+            : nullptr;
     llvm::BasicBlock *IfEndBlock =
         llvm::BasicBlock::Create(ctx, "if.end", parent, nullptr);
-    builder.CreateBr(IfHeaderBlock);
-    builder.SetInsertPoint(IfHeaderBlock);
     v->condition->accept(this);
-    if (v->condition->getUType()->getRawTypeValue() == RawTypeValue::POINTER)
+    if (typeOf(*v->condition)->getRawTypeValue() == RawTypeValue::POINTER)
       rec_val = builder.CreateIsNotNull(rec_val, "notnull");
     rec_val =
         builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
     // always comapare condition to false (accepting all nonzero values as
     // true)
     auto c = builder.CreateICmpNE(rec_val, builder.getInt32(0), "condition");
-    builder.CreateCondBr(c, IfConsequenceBlock, IfAlternativeBlock);
+    if (instrument)
+      increment(counters[v->getId()]);
+    builder.CreateCondBr(c, IfConsequenceBlock,
+                         IfAlternativeBlock ? IfAlternativeBlock : IfEndBlock,
+                         weights(counters[v->getId()]));
+    sealBlock(IfConsequenceBlock);
     builder.SetInsertPoint(IfConsequenceBlock);
-    v->ifStmt->accept(this);
-    builder.CreateBr(IfEndBlock);
-    builder.SetInsertPoint(IfAlternativeBlock);
-    if (v->elseStmt)
-      v->elseStmt->accept(this);
-    builder.CreateBr(IfEndBlock);
+    if (instrument)
+      increment(counters[v->getId()] + 1);
+    statement(v->ifStmt.get());
+    jump(IfEndBlock);
+    if (IfAlternativeBlock) {
+      sealBlock(IfAlternativeBlock);
+      builder.SetInsertPoint(IfAlternativeBlock);
+      statement(v->elseStmt.get());
+      jump(IfEndBlock);
+    }
+    // both branches left the statement
+    if (llvm::pred_empty(IfEndBlock)) {
+      IfEndBlock->eraseFromParent();
+      return;
+    }
+    sealBlock(IfEndBlock);
     builder.SetInsertPoint(IfEndBlock);
   }
 
@@ -283,13 +1436,17 @@ public:
    *
    * @param v visitor
    */
-  void visitLabel(Label *v) override {
-    llvm::BasicBlock *l = llvm::BasicBlock::Create(
-        ctx, "label." + v->label_name->name, parent, nullptr);
-    labels[v->label_name->name] = l;
-    builder.CreateBr(l);
+  void visitLabel(Label *v) {
+    auto &l = labels[v->label_name->name];
+    // block of a label used before gets its position now
+    if (l)
+      l->insertInto(parent);
+    else
+      l = llvm::BasicBlock::Create(ctx, "label." + v->label_name->name, parent,
+                                   nullptr);
+    jump(l);
     builder.SetInsertPoint(l);
-    v->stmt->accept(this);
+    statement(v->stmt.get());
   }
 
   /**
@@ -297,7 +1454,7 @@ public:
    *
    * @param v visitor
    */
-  void visitWhile(While *v) override {
+  void visitWhile(While *v) {
     llvm::BasicBlock *whileHeaderBlock =
         llvm::BasicBlock::Create(ctx, "while.header", parent, nullptr);
     llvm::BasicBlock *whileBodyBlock =
@@ -313,27 +1470,35 @@ public:
     rec_val =
         builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
     auto c = builder.CreateICmpNE(rec_val, builder.getInt32(0), "condition");
-    builder.CreateCondBr(c, whileBodyBlock, whileEndBlock);
+    if (instrument)
+      increment(counters[v->getId()]);
+    builder.CreateCondBr(c, whileBodyBlock, whileEndBlock,
+                         weights(counters[v->getId()]));
+    sealBlock(whileBodyBlock);
     builder.SetInsertPoint(whileBodyBlock);
-    v->block->accept(this);
-    builder.CreateBr(whileHeaderBlock);
+    if (instrument)
+      increment(counters[v->getId()] + 1);
+    statement(v->block.get());
+    jump(whileHeaderBlock);
+    // all continues and breaks are known now
+    sealBlock(whileHeaderBlock);
+    sealBlock(whileEndBlock);
     builder.SetInsertPoint(whileEndBlock);
     continues.pop_back();
     breaks.pop_back();
   }
 
   /**
-   * insert a empty block that only gets a jump instruction in the end - in that
-   * way handling undefined labels
+   * branch to the block of the label, a label which follows gets its block
+   * here and is placed in the function once it is reached
    *
    * @param v visitor
    */
-  void visitGoto(Goto *v) override {
-    (void)v;
-    llvm::BasicBlock *b = llvm::BasicBlock::Create(
-        ctx, "goto." + v->label_name->name, parent, nullptr);
-    builder.CreateBr(b);
-    ulabels[v->label_name->name] = b;
+  void visitGoto(Goto *v) {
+    auto &l = labels[v->label_name->name];
+    if (!l)
+      l = llvm::BasicBlock::Create(ctx, "label." + v->label_name->name);
+    jump(l);
   }
 
   /**
@@ -341,7 +1506,7 @@ public:
    *
    * @param v visitor
    */
-  void visitExpressionStmt(ExpressionStmt *v) override {
+  void visitExpressionStmt(ExpressionStmt *v) {
     if (v->expr)
       v->expr->accept(this);
   }
@@ -350,14 +1515,14 @@ public:
    * jump to loop end
    *
    */
-  void visitBreak(Break *) override { builder.CreateBr(breaks.back()); }
+  void visitBreak(Break *) { jump(breaks.back()); }
 
   /**
-   * generate return value, insert a dead block afterwards
+   * generate return value, following code is unreachable
    *
    * @param v visitor
    */
-  void visitReturn(Return *v) override {
+  void visitReturn(Return *v) {
     if (v->expr) {
       v->expr->accept(this);
       rec_val = builder.CreateZExtOrTrunc(
@@ -365,29 +1530,29 @@ public:
       builder.CreateRet(rec_val);
     } else
       builder.CreateRet(llvm::Constant::getNullValue(parent->getReturnType()));
-    llvm::BasicBlock *ReturnDeadBlock =
-        llvm::BasicBlock::Create(ctx, "DEAD_BLOCK", parent, nullptr);
-    builder.SetInsertPoint(ReturnDeadBlock);
+    builder.ClearInsertionPoint();
   }
 
   /**
    * jump to loop header
    *
    */
-  void visitContinue(Continue *) override {
-    builder.CreateBr(continues.back());
-  }
+  void visitContinue(Continue *) { jump(continues.back()); }
 
   /**
    * perform lookup of object in global maps
    *
    * @param v visitor
    */
-  void visitVariableName(VariableName *v) override {
-    if (functions[v->getUIdentifier()])
-      rec_val = functions[v->getUIdentifier()];
+  void visitVariableName(VariableName *v) {
+    const auto &slot = slots[symbolOf(*v)];
+    if (slot.reg) {
+      load = nullptr;
+      rec_val = readVariable(symbolOf(*v), builder.GetInsertBlock());
+    } else if (slot.value && llvm::isa<llvm::Function>(slot.value))
+      rec_val = slot.value;
     else {
-      load = declarations[v->getUIdentifier()];
+      load = slot.value;
       rec_val = builder.CreateLoad(load, v->name);
     }
   }
@@ -397,122 +1562,86 @@ public:
    *
    * @param v visitor
    */
-  void visitNumber(Number *v) override {
+  void visitNumber(Number *v) {
     rec_val = builder.getInt32(static_cast<uint32_t>(v->num_value));
   }
 
   /**
    * @param v visitor
    */
-  void visitCharacter(Character *v) override {
-    unsigned int val = 0;
-    // value of escaped character
-    if (v->char_value[0] == '\\') {
-      switch (v->char_value[1]) {
-      case 'a':
-        val = 7;
-        break;
-      case 'b':
-        val = 8;
-        break;
-      case 'f':
-        val = 12;
-        break;
-      case 'n':
-        val = 10;
-        break;
-      case 'r':
-        val = 13;
-        break;
-      case 't':
-        val = 9;
-        break;
-      case 'v':
-        val = 11;
-        break;
-      case '\\':
-        val = 92;
-        break;
-      case '\'':
-        val = 39;
-        break;
-      case '\"':
-        val = 34;
-        break;
-      case '?':
-        val = 63;
-        break;
-      case '0':
-        val = 0;
-        break;
-      default:
-        break;
-      }
-    } else
-      val = (unsigned int)(v->char_value[0]);
-    rec_val = builder.getInt32(val);
-  }
+  void visitCharacter(Character *v) { rec_val = builder.getInt32(v->value()); }
 
   /**
    * @param v visitor
    */
-  void visitString(String *v) override {
-    std::stringstream ss;
+  void visitString(String *v) {
+    std::string ss;
     for (unsigned int i = 0; i < v->str_value.size(); i++) {
       // replace escaped character
       if (v->str_value[i] == '\\') {
         switch (v->str_value[++i]) {
         case 'a':
-          ss << '\a';
+          ss += '\a';
           break;
         case 'b':
-          ss << '\b';
+          ss += '\b';
           break;
         case 'f':
-          ss << '\f';
+          ss += '\f';
           break;
         case 'n':
-          ss << '\n';
+          ss += '\n';
           break;
         case 'r':
-          ss << '\r';
+          ss += '\r';
           break;
         case 't':
-          ss << '\t';
+          ss += '\t';
           break;
         case 'v':
-          ss << '\v';
+          ss += '\v';
           break;
         case '\\':
-          ss << '\\';
+          ss += '\\';
           break;
         case '\'':
-          ss << '\'';
+          ss += '\'';
           break;
         case '\"':
-          ss << '\"';
+          ss += '\"';
           break;
         case '?':
-          ss << '\?';
+          ss += '\?';
           break;
         case '0':
-          ss << '\0';
+          ss += '\0';
           break;
         default:
           break;
         }
       } else
-        ss << v->str_value[i];
+        ss += v->str_value[i];
+    }
+    auto &pooled = strings[ss];
+    if (pooled) {
+      rec_val = pooled;
+      return;
     }
-    rec_val = builder.CreateGlobalString(ss.str(), "string");
-    rec_val = builder.CreatePointerBitCastOrAddrSpaceCast(
-        rec_val, builder.getInt8PtrTy(), "cast");
+    auto data = llvm::ConstantDataArray::getString(ctx, ss);
+    auto global =
+        new llvm::GlobalVariable(mod, data->getType(), true,
+                                 llvm::GlobalValue::PrivateLinkage, data,
+                                 "string");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(1);
+    pooled = llvm::ConstantExpr::getPointerCast(global, builder.getInt8PtrTy());
+    rec_val = pooled;
   }
 
   /**
    * @param v visitor
    */
-  void visitMemberAccessOp(MemberAccessOp *v) override {
+  void visitMemberAccessOp(MemberAccessOp *v) {
     (void)v; // TODO WIP
   }
 
@@ -521,7 +1650,7 @@ public:
    *
    * @param v visitor
    */
-  void visitArraySubscriptOp(ArraySubscriptOp *v) override {
+  void visitArraySubscriptOp(ArraySubscriptOp *v) {
     v->array_name->accept(this);
     auto callee = rec_val;
     v->index_value->accept(this);
@@ -538,19 +1667,19 @@ public:
    *
    * @param v visitor
    */
-  void visitFunctionCall(FunctionCall *v) override {
+  void visitFunctionCall(FunctionCall *v) {
     v->callee_name->accept(this);
     auto callee = rec_val;
     std::vector<llvm::Value *> args;
     unsigned int pos = 0;
     for (const auto &a : v->callee_args) {
       a->accept(this);
-      if (a->getUType()->getRawTypeValue() == RawTypeValue::POINTER)
+      if (typeOf(*a)->getRawTypeValue() == RawTypeValue::POINTER)
         rec_val = builder.CreateBitOrPointerCast(
-            rec_val, a->getUType()->getLLVMType(builder), "cast");
+            rec_val, typeOf(*a)->getLLVMType(llvm_types), "cast");
       else
         rec_val = builder.CreateZExtOrTrunc(
-            rec_val, a->getUType()->getLLVMType(builder), "zext");
+            rec_val, typeOf(*a)->getLLVMType(llvm_types), "zext");
       pos++;
       args.push_back(rec_val);
     }
@@ -562,7 +1691,7 @@ public:
    *
    * @param v visitor
    */
-  void visitUnary(Unary *v) override {
+  void visitUnary(Unary *v) {
     v->operand->accept(this);
     switch (v->op_kind) {
     case UnaryOpValue::ADDRESS_OF:
@@ -580,7 +1709,7 @@ public:
       break;
     case UnaryOpValue::NOT:
       // pointer not null
-      if (v->operand->getUType()->getRawTypeValue() == RawTypeValue::POINTER) {
+      if (typeOf(*v->operand)->getRawTypeValue() == RawTypeValue::POINTER) {
         rec_val = builder.CreateIsNull(rec_val, "isnull");
       } else {
         // negate boolean value
@@ -598,35 +1727,14 @@ public:
   /**
    * @param v visitor
    */
-  void visitSizeOf(SizeOf *v) override {
-    if (v->operand)
-      // expression
-      rec_val = builder.getInt32(
-          static_cast<uint32_t>(v->operand->getUType()->size()));
-    else if (v->type_name->getUType())
-      // type
-      rec_val = builder.getInt32(
-          static_cast<uint32_t>(v->type_name->getUType()->size()));
-    else
-      rec_val = builder.getInt32(0);
-    // sizeof sizeof
-    if (v->operand && v->operand->isSizeOf()) {
-      rec_val = builder.getInt32(8);
-    } else if (v->operand && v->operand->getString()) {
-      // calculate length of string without escape sequences but with tailing
-      // \0
-      auto str = v->operand->getString()->str_value;
-      str.erase(std::remove(str.begin(), str.end(), '\\'), str.end());
-      rec_val = builder.getInt32(static_cast<uint32_t>(str.size() + 1));
-    }
-  }
+  void visitSizeOf(SizeOf *v) { rec_val = builder.getInt32(v->value(*table)); }
 
   /**
    * generate code for binary expressions
    *
    * @param v visitor
    */
-  void visitBinary(Binary *v) override {
+  void visitBinary(Binary *v) {
     llvm::Value *lhs = nullptr;
     llvm::Value *rhs = nullptr;
     switch (v->op_kind) {
@@ -663,11 +1771,11 @@ public:
       v->right_operand->accept(this);
       rhs = rec_val;
       // pointer arithmetic
-      if (v->left_operand->getUType()->getRawTypeValue() ==
+      if (typeOf(*v->left_operand)->getRawTypeValue() ==
           RawTypeValue::POINTER) {
         load = builder.CreateGEP(lhs, rhs, "gep");
         rec_val = load;
-      } else if (v->right_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->right_operand)->getRawTypeValue() ==
                  RawTypeValue::POINTER) {
         load = builder.CreateGEP(rhs, lhs, "gep");
         rec_val = load;
@@ -687,24 +1795,24 @@ public:
       v->right_operand->accept(this);
       rhs = rec_val;
       // pointer arithmetic
-      if (v->left_operand->getUType()->getRawTypeValue() ==
+      if (typeOf(*v->left_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER ||
-          v->right_operand->getUType()->getRawTypeValue() ==
+          typeOf(*v->right_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER) {
-        if (v->left_operand->getUType()->getRawTypeValue() ==
+        if (typeOf(*v->left_operand)->getRawTypeValue() ==
             RawTypeValue::NIL) {
           rec_val = rhs;
           break;
-        } else if (v->right_operand->getUType()->getRawTypeValue() ==
+        } else if (typeOf(*v->right_operand)->getRawTypeValue() ==
                    RawTypeValue::NIL) {
           rec_val = lhs;
           break;
-        } else if (v->left_operand->getUType()->getRawTypeValue() ==
+        } else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                    RawTypeValue::INT) {
           lhs = builder.CreateNeg(lhs, "minus");
           load = builder.CreateGEP(rhs, lhs, "gep");
           rec_val = load;
-        } else if (v->right_operand->getUType()->getRawTypeValue() ==
+        } else if (typeOf(*v->right_operand)->getRawTypeValue() ==
                    RawTypeValue::INT) {
           rhs = builder.CreateNeg(rhs, "minus");
           load = builder.CreateGEP(lhs, rhs, "gep");
@@ -717,15 +1825,15 @@ public:
           rec_val = builder.CreateExactSDiv(
               rec_val,
               builder.getInt32(static_cast<uint32_t>(
-                  v->left_operand->getUType()->ptr_size())),
+                  typeOf(*v->left_operand)->ptr_size())),
               "div");
           rec_val = builder.CreateTrunc(rec_val, builder.getInt32Ty(), "trunc");
         }
       } else {
         // subtract numbers
-        if (v->left_operand->getUType()->getRawTypeValue() ==
+        if (typeOf(*v->left_operand)->getRawTypeValue() ==
                 RawTypeValue::CHAR &&
-            v->right_operand->getUType()->getRawTypeValue() ==
+            typeOf(*v->right_operand)->getRawTypeValue() ==
                 RawTypeValue::CHAR) {
         } else {
           lhs = builder.CreateZExtOrBitCast(lhs, builder.getInt32Ty(), "zext");
@@ -740,20 +1848,20 @@ public:
       v->right_operand->accept(this);
       rhs = rec_val;
       // compare pointer
-      if (v->left_operand->getUType()->getRawTypeValue() ==
+      if (typeOf(*v->left_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER &&
-          v->right_operand->getUType()->getRawTypeValue() ==
+          typeOf(*v->right_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER) {
         rec_val = builder.getInt1(lhs->getType() == rhs->getType());
-      } else if (v->left_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                      RawTypeValue::NIL &&
-                 v->right_operand->getUType()->getRawTypeValue() ==
+                 typeOf(*v->right_operand)->getRawTypeValue() ==
                      RawTypeValue::NIL) {
         rec_val = builder.getInt1(true);
-      } else if (v->left_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                  RawTypeValue::NIL) {
         rec_val = builder.CreateIsNull(rhs, "isnull");
-      } else if (v->right_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->right_operand)->getRawTypeValue() ==
                  RawTypeValue::NIL) {
         rec_val = builder.CreateIsNull(lhs, "isnull");
       } else {
@@ -775,20 +1883,20 @@ public:
       v->right_operand->accept(this);
       rhs = rec_val;
       // compare pointer
-      if (v->left_operand->getUType()->getRawTypeValue() ==
+      if (typeOf(*v->left_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER &&
-          v->right_operand->getUType()->getRawTypeValue() ==
+          typeOf(*v->right_operand)->getRawTypeValue() ==
               RawTypeValue::POINTER) {
         rec_val = builder.getInt1(lhs->getType() != rhs->getType());
-      } else if (v->left_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                      RawTypeValue::NIL &&
-                 v->right_operand->getUType()->getRawTypeValue() ==
+                 typeOf(*v->right_operand)->getRawTypeValue() ==
                      RawTypeValue::NIL) {
         rec_val = builder.getInt1(false);
-      } else if (v->left_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                  RawTypeValue::NIL) {
         rec_val = builder.CreateIsNotNull(rhs, "notnull");
-      } else if (v->right_operand->getUType()->getRawTypeValue() ==
+      } else if (typeOf(*v->right_operand)->getRawTypeValue() ==
                  RawTypeValue::NIL) {
         rec_val = builder.CreateIsNotNull(lhs, "notnull");
       } else {
@@ -805,81 +1913,67 @@ public:
           builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
       break;
     case BinaryOpValue::LOGICAL_AND: {
-      llvm::BasicBlock *lazy_h =
-          llvm::BasicBlock::Create(ctx, "land.rhs", parent, nullptr);
-      llvm::BasicBlock *lazy_e =
-          llvm::BasicBlock::Create(ctx, "land.end", parent, nullptr);
-      // store result of lazy evaluation
-      allocBuilder.SetInsertPoint(allocBuilder.GetInsertBlock(),
-                                  allocBuilder.GetInsertBlock()->begin());
-      llvm::Value *tmp = allocBuilder.CreateAlloca(builder.getInt1Ty());
-      tmp->setName("lazy");
       v->left_operand->accept(this);
-      lhs = rec_val;
-      if (v->left_operand->getUType()->getRawTypeValue() ==
-          RawTypeValue::POINTER)
-        lhs = builder.CreateIsNotNull(lhs, "notnull");
-      else {
-        lhs = builder.CreateZExtOrBitCast(lhs, builder.getInt32Ty(), "zext");
-        lhs = builder.CreateICmpNE(lhs, builder.getInt32(0), "cmp");
-      }
-      builder.CreateStore(lhs, tmp);
-      // evaluate right expression only if left returned true
-      builder.CreateCondBr(lhs, lazy_h, lazy_e);
-      builder.SetInsertPoint(lazy_h);
-      v->right_operand->accept(this);
-      rhs = rec_val;
-      if (v->right_operand->getUType()->getRawTypeValue() ==
-          RawTypeValue::POINTER)
-        rhs = builder.CreateIsNotNull(rhs, "notnull");
-      else {
-        rhs = builder.CreateZExtOrBitCast(rhs, builder.getInt32Ty(), "zext");
-        rhs = builder.CreateICmpNE(rhs, builder.getInt32(0), "cmp");
+      lhs = truth(*v->left_operand, rec_val);
+      if (cheap(v->right_operand.get())) {
+        // no need to branch around a right side without effects
+        v->right_operand->accept(this);
+        rhs = truth(*v->right_operand, rec_val);
+        rec_val = builder.CreateSelect(lhs, rhs, builder.getFalse(), "land");
+      } else {
+        llvm::BasicBlock *lazy_h =
+            llvm::BasicBlock::Create(ctx, "land.rhs", parent, nullptr);
+        llvm::BasicBlock *lazy_e =
+            llvm::BasicBlock::Create(ctx, "land.end", parent, nullptr);
+        auto lhs_block = builder.GetInsertBlock();
+        // evaluate right expression only if left returned true
+        builder.CreateCondBr(lhs, lazy_h, lazy_e);
+        sealBlock(lazy_h);
+        builder.SetInsertPoint(lazy_h);
+        v->right_operand->accept(this);
+        rhs = truth(*v->right_operand, rec_val);
+        auto rhs_block = builder.GetInsertBlock();
+        builder.CreateBr(lazy_e);
+        sealBlock(lazy_e);
+        builder.SetInsertPoint(lazy_e);
+        auto phi = builder.CreatePHI(builder.getInt1Ty(), 2, "land");
+        phi->addIncoming(builder.getFalse(), lhs_block);
+        phi->addIncoming(rhs, rhs_block);
+        rec_val = phi;
       }
-      builder.CreateStore(rhs, tmp);
-      builder.CreateBr(lazy_e);
-      builder.SetInsertPoint(lazy_e);
-      rec_val = builder.CreateLoad(tmp, "lazy");
       rec_val =
           builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
       break;
     }
     case BinaryOpValue::LOGICAL_OR: {
-      llvm::BasicBlock *lazy_h =
-          llvm::BasicBlock::Create(ctx, "lor.rhs", parent, nullptr);
-      llvm::BasicBlock *lazy_e =
-          llvm::BasicBlock::Create(ctx, "lor.end", parent, nullptr);
-      // store result of lazy evaluation
-      allocBuilder.SetInsertPoint(allocBuilder.GetInsertBlock(),
-                                  allocBuilder.GetInsertBlock()->begin());
-      llvm::Value *tmp = allocBuilder.CreateAlloca(builder.getInt1Ty());
-      tmp->setName("lazy");
       v->left_operand->accept(this);
-      lhs = rec_val;
-      if (v->left_operand->getUType()->getRawTypeValue() ==
-          RawTypeValue::POINTER)
-        lhs = builder.CreateIsNotNull(lhs, "notnull");
-      else {
-        lhs = builder.CreateZExtOrBitCast(lhs, builder.getInt32Ty(), "zext");
-        lhs = builder.CreateICmpNE(lhs, builder.getInt32(0), "cmp");
-      }
-      builder.CreateStore(lhs, tmp);
-      // evaluate right expression only if left returned false
-      builder.CreateCondBr(lhs, lazy_e, lazy_h);
-      builder.SetInsertPoint(lazy_h);
-      v->right_operand->accept(this);
-      rhs = rec_val;
-      if (v->right_operand->getUType()->getRawTypeValue() ==
-          RawTypeValue::POINTER)
-        rhs = builder.CreateIsNotNull(rhs, "notnull");
-      else {
-        rhs = builder.CreateZExtOrBitCast(rhs, builder.getInt32Ty(), "zext");
-        rhs = builder.CreateICmpNE(rhs, builder.getInt32(0), "cmp");
+      lhs = truth(*v->left_operand, rec_val);
+      if (cheap(v->right_operand.get())) {
+        // no need to branch around a right side without effects
+        v->right_operand->accept(this);
+        rhs = truth(*v->right_operand, rec_val);
+        rec_val = builder.CreateSelect(lhs, builder.getTrue(), rhs, "lor");
+      } else {
+        llvm::BasicBlock *lazy_h =
+            llvm::BasicBlock::Create(ctx, "lor.rhs", parent, nullptr);
+        llvm::BasicBlock *lazy_e =
+            llvm::BasicBlock::Create(ctx, "lor.end", parent, nullptr);
+        auto lhs_block = builder.GetInsertBlock();
+        // evaluate right expression only if left returned false
+        builder.CreateCondBr(lhs, lazy_e, lazy_h);
+        sealBlock(lazy_h);
+        builder.SetInsertPoint(lazy_h);
+        v->right_operand->accept(this);
+        rhs = truth(*v->right_operand, rec_val);
+        auto rhs_block = builder.GetInsertBlock();
+        builder.CreateBr(lazy_e);
+        sealBlock(lazy_e);
+        builder.SetInsertPoint(lazy_e);
+        auto phi = builder.CreatePHI(builder.getInt1Ty(), 2, "lor");
+        phi->addIncoming(builder.getTrue(), lhs_block);
+        phi->addIncoming(rhs, rhs_block);
+        rec_val = phi;
       }
-      builder.CreateStore(rhs, tmp);
-      builder.CreateBr(lazy_e);
-      builder.SetInsertPoint(lazy_e);
-      rec_val = builder.CreateLoad(tmp, "lazy");
       rec_val =
           builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
       break;
@@ -895,63 +1989,59 @@ public:
    *
    * @param v visitor
    */
-  void visitTernary(Ternary *v) override {
-    llvm::BasicBlock *ternaryHeaderBlock =
-        llvm::BasicBlock::Create(ctx, "ternary.header", parent, nullptr);
+  void visitTernary(Ternary *v) {
+    // calculate result type of both branches
+    llvm::Type *type = builder.getInt32Ty();
+    if (typeOf(*v->left_branch)->getRawTypeValue() == RawTypeValue::CHAR &&
+        typeOf(*v->right_branch)->getRawTypeValue() == RawTypeValue::CHAR)
+      type = builder.getInt8Ty();
+    if (typeOf(*v->left_branch)->getRawTypeValue() == RawTypeValue::POINTER)
+      type = typeOf(*v->left_branch)->getLLVMType(llvm_types);
+    else if (typeOf(*v->right_branch)->getRawTypeValue() ==
+             RawTypeValue::POINTER)
+      type = typeOf(*v->right_branch)->getLLVMType(llvm_types);
+    // null pointer constants are never evaluated
+    auto flat = [this](Expression *e) {
+      return typeOf(*e)->getRawTypeValue() == RawTypeValue::NIL || cheap(e);
+    };
+    if (flat(v->left_branch.get()) && flat(v->right_branch.get())) {
+      // evaluate both branches and select without branching
+      v->predicate->accept(this);
+      auto c = truth(*v->predicate, rec_val);
+      auto left = branchValue(*v->left_branch, type);
+      auto right = branchValue(*v->right_branch, type);
+      rec_val = builder.CreateSelect(c, left, right, "ternary");
+      return;
+    }
     llvm::BasicBlock *ternaryConsequenceBlock =
         llvm::BasicBlock::Create(ctx, "ternary.consequence", parent, nullptr);
     llvm::BasicBlock *ternaryAlternativeBlock =
         llvm::BasicBlock::Create(ctx, "ternary.alternative", parent, nullptr);
     llvm::BasicBlock *ternaryEndBlock =
         llvm::BasicBlock::Create(ctx, "ternary.end", parent, nullptr);
-    builder.CreateBr(ternaryHeaderBlock);
-    builder.SetInsertPoint(ternaryHeaderBlock);
     // generate conditional branching
     v->predicate->accept(this);
-    if (v->predicate->getUType()->getRawTypeValue() == RawTypeValue::POINTER)
-      rec_val = builder.CreateIsNotNull(rec_val);
-    rec_val =
-        builder.CreateZExtOrBitCast(rec_val, builder.getInt32Ty(), "zext");
-    auto c = builder.CreateICmpNE(rec_val, builder.getInt32(0), "condition");
+    auto c = truth(*v->predicate, rec_val);
     builder.CreateCondBr(c, ternaryConsequenceBlock, ternaryAlternativeBlock);
-    builder.SetInsertPoint(ternaryConsequenceBlock);
-    // calculate result type of both branches
-    llvm::Type *type = builder.getInt32Ty();
-    if (v->left_branch->getUType()->getRawTypeValue() == RawTypeValue::CHAR &&
-        v->right_branch->getUType()->getRawTypeValue() == RawTypeValue::CHAR)
-      type = builder.getInt8Ty();
-    if (v->left_branch->getUType()->getRawTypeValue() == RawTypeValue::POINTER)
-      type = v->left_branch->getUType()->getLLVMType(builder);
-    else if (v->right_branch->getUType()->getRawTypeValue() ==
-             RawTypeValue::POINTER)
-      type = v->right_branch->getUType()->getLLVMType(builder);
-    // use a temporay variable to store result of branch evaluation
-    allocBuilder.SetInsertPoint(allocBuilder.GetInsertBlock(),
-                                allocBuilder.GetInsertBlock()->begin());
-    llvm::Value *tmp = allocBuilder.CreateAlloca(type);
-    tmp->setName("ternary.val");
+    sealBlock(ternaryConsequenceBlock);
+    sealBlock(ternaryAlternativeBlock);
     // calculate result of left branch
-    if (v->left_branch->getUType()->getRawTypeValue() == RawTypeValue::NIL)
-      rec_val = llvm::Constant::getNullValue(type);
-    else {
-      v->left_branch->accept(this);
-      rec_val = builder.CreateZExtOrTrunc(rec_val, type);
-    }
-    builder.CreateStore(rec_val, tmp);
+    builder.SetInsertPoint(ternaryConsequenceBlock);
+    auto left = branchValue(*v->left_branch, type);
+    auto left_block = builder.GetInsertBlock();
     builder.CreateBr(ternaryEndBlock);
     // calculate result of right branch
     builder.SetInsertPoint(ternaryAlternativeBlock);
-    if (v->right_branch->getUType()->getRawTypeValue() == RawTypeValue::NIL)
-      rec_val = llvm::Constant::getNullValue(type);
-    else {
-      v->right_branch->accept(this);
-      rec_val = builder.CreateZExtOrTrunc(rec_val, type);
-    }
-    builder.CreateStore(rec_val, tmp);
+    auto right = branchValue(*v->right_branch, type);
+    auto right_block = builder.GetInsertBlock();
     builder.CreateBr(ternaryEndBlock);
+    sealBlock(ternaryEndBlock);
     builder.SetInsertPoint(ternaryEndBlock);
-    // load result which contains value of executed branch
-    rec_val = builder.CreateLoad(tmp);
+    // merge value of executed branch
+    auto phi = builder.CreatePHI(type, 2, "ternary");
+    phi->addIncoming(left, left_block);
+    phi->addIncoming(right, right_block);
+    rec_val = phi;
   }
 
   /**
@@ -960,30 +2050,44 @@ public:
    *
    * @param v visitor
    */
-  void visitAssignment(Assignment *v) override {
-    v->left_operand->accept(this);
-    auto lhs = load;
+  void visitAssignment(Assignment *v) {
+    auto var = dyn_cast<VariableName>(v->left_operand);
+    llvm::Value *lhs = nullptr;
+    if (!var || !slots[symbolOf(*var)].reg) {
+      v->left_operand->accept(this);
+      lhs = load;
+    }
     v->right_operand->accept(this);
     auto rhs = rec_val;
-    if (v->left_operand->getUType()->getRawTypeValue() == RawTypeValue::INT &&
-        v->right_operand->getUType()->getRawTypeValue() == RawTypeValue::CHAR)
+    if (typeOf(*v->left_operand)->getRawTypeValue() == RawTypeValue::INT &&
+        typeOf(*v->right_operand)->getRawTypeValue() == RawTypeValue::CHAR)
       rhs = builder.CreateZExtOrBitCast(rhs, builder.getInt32Ty(), "zext");
-    else if (v->left_operand->getUType()->getRawTypeValue() ==
+    else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                  RawTypeValue::CHAR &&
-             v->right_operand->getUType()->getRawTypeValue() ==
+             typeOf(*v->right_operand)->getRawTypeValue() ==
                  RawTypeValue::INT)
       rhs = builder.CreateTrunc(rhs, builder.getInt8Ty(), "trunc");
-    else if (v->left_operand->getUType()->getRawTypeValue() ==
+    else if (typeOf(*v->left_operand)->getRawTypeValue() ==
                  RawTypeValue::POINTER &&
-             v->right_operand->getUType()->getRawTypeValue() ==
+             typeOf(*v->right_operand)->getRawTypeValue() ==
                  RawTypeValue::NIL)
       rhs = llvm::Constant::getNullValue(
-          v->left_operand->getUType()->getLLVMType(builder));
-    else if (v->left_operand->getUType()->getRawTypeValue() ==
+          typeOf(*v->left_operand)->getLLVMType(llvm_types));
+    else if (typeOf(*v->left_operand)->getRawTypeValue() ==
              RawTypeValue::POINTER)
       rhs = builder.CreatePointerBitCastOrAddrSpaceCast(
-          rhs, v->left_operand->getUType()->getLLVMType(builder), "cast");
-    builder.CreateStore(rhs, lhs);
+          rhs, typeOf(*v->left_operand)->getLLVMType(llvm_types), "cast");
+    if (lhs) {
+      builder.CreateStore(rhs, lhs);
+      rec_val = rhs;
+      return;
+    }
+    // keep definitions of a register at its own type
+    auto type = registers[slots[symbolOf(*var)].reg - 1].type;
+    if (rhs->getType() != type && rhs->getType()->isIntegerTy() &&
+        type->isIntegerTy())
+      rhs = builder.CreateZExtOrTrunc(rhs, type, "conv");
+    writeVariable(symbolOf(*var), builder.GetInsertBlock(), rhs);
     rec_val = rhs;
   }
 };
@@ -0,0 +1,462 @@
+#ifndef C4_CONSTANT_FOLDING_VISITOR_HPP
+#define C4_CONSTANT_FOLDING_VISITOR_HPP
+#include "../ast_node.hpp"
+#include "../traversal.hpp"
+
+namespace ccc {
+/**
+ * AST visitor folding constant expressions, removing identities and pruning
+ * statements with constant conditions - runs between semantic analysis and
+ * codegen, the result is still a valid AST for all other visitors
+ *
+ * replacing nodes take over the id of the replaced expression, so they keep
+ * the type semantic analysis gave to it, and codegen sees the same types as
+ * without folding
+ */
+class ConstantFoldingVisitor
+    : public StaticVisitor<ConstantFoldingVisitor, void> {
+  // annotations from semantic analysis
+  SemanticTable *table = nullptr;
+  // node taking the place of the visited one, set by its visit
+  std::unique_ptr<ASTNode> replacement;
+
+  RawType *typeOf(const ASTNode &n) { return table->getType(n); }
+
+  /**
+   * visit a child and put its replacement in its slot
+   *
+   * @param slot child of the visited node
+   */
+  template <class T> void fold(std::unique_ptr<T> &slot) {
+    if (!slot)
+      return;
+    slot->accept(this);
+    if (replacement)
+      slot.reset(cast<T>(replacement.release()));
+  }
+
+  /**
+   * @param v expression
+   * @param value set to the value of v, with the 32 bit wrap around of codegen
+   * @return if v is a number or character literal
+   */
+  static bool constant(Expression *v, long &value) {
+    if (auto n = dyn_cast<Number>(v))
+      value = static_cast<int>(static_cast<unsigned int>(n->num_value));
+    else if (auto c = dyn_cast<Character>(v))
+      value = static_cast<int>(c->value());
+    else
+      return false;
+    return true;
+  }
+
+  /**
+   * @param v expression
+   * @return if v can only be 0 or 1
+   */
+  static bool boolean(Expression *v) {
+    if (auto u = dyn_cast<Unary>(v))
+      return u->op_kind == UnaryOpValue::NOT;
+    if (auto b = dyn_cast<Binary>(v))
+      return b->op_kind == BinaryOpValue::LESS_THAN ||
+             b->op_kind == BinaryOpValue::EQUAL ||
+             b->op_kind == BinaryOpValue::NOT_EQUAL ||
+             b->op_kind == BinaryOpValue::LOGICAL_AND ||
+             b->op_kind == BinaryOpValue::LOGICAL_OR;
+    return false;
+  }
+
+  /**
+   * @param s statement
+   * @return if s contains a label, which could be jumped to from outside
+   */
+  static bool labelled(Statement *s) {
+    bool found = false;
+    preOrder(s, [&found](ASTNode *n) { found |= isa<Label>(n); });
+    return found;
+  }
+
+  /**
+   * replace the visited expression by a literal
+   *
+   * @param v folded expression
+   * @param value result of v
+   */
+  void replaceByNumber(const Expression &v, long value) {
+    auto n = make_unique<Number>(Token(TokenType::NUMBER, v.getLocation()),
+                                 static_cast<int>(value));
+    n->setId(v.getId());
+    replacement = std::move(n);
+  }
+
+  /**
+   * replace the visited expression by one of its operands, if the type stays
+   * the same
+   *
+   * @param v simplified expression
+   * @param operand slot of the remaining operand
+   */
+  void replaceByOperand(const Expression &v,
+                        std::unique_ptr<Expression> &operand) {
+    if (typeOf(v) == typeOf(*operand))
+      replacement = std::move(operand);
+  }
+
+  /**
+   * fold a condition, whose value is only compared against 0
+   *
+   * @param slot condition
+   */
+  void foldCondition(std::unique_ptr<Expression> &slot) {
+    fold(slot);
+    // !!c is as true as c
+    auto outer = dyn_cast<Unary>(slot);
+    if (!outer || outer->op_kind != UnaryOpValue::NOT)
+      return;
+    auto inner = dyn_cast<Unary>(outer->operand);
+    if (inner && inner->op_kind == UnaryOpValue::NOT &&
+        typeOf(*inner->operand)->getRawTypeValue() != RawTypeValue::POINTER) {
+      auto c = std::move(inner->operand);
+      slot = std::move(c);
+    }
+  }
+
+  /**
+   * drop the visited statement, an empty block takes its place
+   *
+   * @param v pruned statement
+   * @param dead its remaining children
+   */
+  void prune(const Statement &v, ASTNodeListType dead) {
+    destroyTree(std::move(dead));
+    auto empty = make_unique<CompoundStmt>(
+        Token(TokenType::BRACE_OPEN, v.getLocation()), ASTNodeListType());
+    empty->setId(v.getId());
+    replacement = std::move(empty);
+  }
+
+public:
+  ConstantFoldingVisitor() = default;
+
+  /**
+   * root of AST
+   *
+   * @param v visitor
+   */
+  void visitTranslationUnit(TranslationUnit *v) {
+    table = &v->table;
+    for (auto &e : v->extern_list)
+      fold(e);
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitFunctionDefinition(FunctionDefinition *v) { fold(v->fn_body); }
+
+  void visitFunctionDeclaration(FunctionDeclaration *) {
+    // EMPTY
+  }
+
+  void visitDataDeclaration(DataDeclaration *) {
+    // EMPTY
+  }
+
+  void visitStructDeclaration(StructDeclaration *) {
+    // EMPTY
+  }
+
+  void visitParamDeclaration(ParamDeclaration *) {
+    // EMPTY
+  }
+
+  void visitScalarType(ScalarType *) {
+    // EMPTY
+  }
+
+  void visitStructType(StructType *) {
+    // EMPTY
+  }
+
+  void visitAbstractType(AbstractType *) {
+    // EMPTY
+  }
+
+  void visitDirectDeclarator(DirectDeclarator *) {
+    // EMPTY
+  }
+
+  void visitAbstractDeclarator(AbstractDeclarator *) {
+    // EMPTY
+  }
+
+  void visitPointerDeclarator(PointerDeclarator *) {
+    // EMPTY
+  }
+
+  void visitFunctionDeclarator(FunctionDeclarator *) {
+    // EMPTY
+  }
+
+  /**
+   * fold all items, empty blocks left by pruning are removed
+   *
+   * @param v visitor
+   */
+  void visitCompoundStmt(CompoundStmt *v) {
+    for (auto &s : v->block_items)
+      fold(s);
+    v->block_items.erase(
+        std::remove_if(v->block_items.begin(), v->block_items.end(),
+                       [](const std::unique_ptr<ASTNode> &s) {
+                         auto c = dyn_cast<CompoundStmt>(s.get());
+                         return c && c->block_items.empty();
+                       }),
+        v->block_items.end());
+  }
+
+  /**
+   * keep only the branch a constant condition selects
+   *
+   * @param v visitor
+   */
+  void visitIfElse(IfElse *v) {
+    foldCondition(v->condition);
+    fold(v->ifStmt);
+    fold(v->elseStmt);
+    long c;
+    if (!constant(v->condition.get(), c))
+      return;
+    auto &taken = c ? v->ifStmt : v->elseStmt;
+    auto &skipped = c ? v->elseStmt : v->ifStmt;
+    if (skipped && labelled(skipped.get()))
+      return;
+    ASTNodeListType dead;
+    dead.push_back(std::move(v->condition));
+    dead.push_back(std::move(skipped));
+    if (taken) {
+      destroyTree(std::move(dead));
+      replacement = std::move(taken);
+    } else
+      prune(*v, std::move(dead));
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitLabel(Label *v) { fold(v->stmt); }
+
+  /**
+   * remove loops which are never entered
+   *
+   * @param v visitor
+   */
+  void visitWhile(While *v) {
+    foldCondition(v->predicate);
+    fold(v->block);
+    long c;
+    if (!constant(v->predicate.get(), c) || c || labelled(v->block.get()))
+      return;
+    ASTNodeListType dead;
+    dead.push_back(std::move(v->predicate));
+    dead.push_back(std::move(v->block));
+    prune(*v, std::move(dead));
+  }
+
+  void visitGoto(Goto *) {
+    // EMPTY
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitExpressionStmt(ExpressionStmt *v) { fold(v->expr); }
+
+  void visitBreak(Break *) {
+    // EMPTY
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitReturn(Return *v) { fold(v->expr); }
+
+  void visitContinue(Continue *) {
+    // EMPTY
+  }
+
+  void visitVariableName(VariableName *) {
+    // EMPTY
+  }
+
+  void visitNumber(Number *) {
+    // EMPTY
+  }
+
+  void visitCharacter(Character *) {
+    // EMPTY
+  }
+
+  void visitString(String *) {
+    // EMPTY
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitMemberAccessOp(MemberAccessOp *v) { fold(v->struct_name); }
+
+  /**
+   * @param v visitor
+   */
+  void visitArraySubscriptOp(ArraySubscriptOp *v) {
+    fold(v->array_name);
+    fold(v->index_value);
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitFunctionCall(FunctionCall *v) {
+    for (auto &a : v->callee_args)
+      fold(a);
+  }
+
+  /**
+   * fold - and ! on constants and !! on values which are 0 or 1 already
+   *
+   * @param v visitor
+   */
+  void visitUnary(Unary *v) {
+    if (v->op_kind == UnaryOpValue::NOT)
+      foldCondition(v->operand);
+    else
+      fold(v->operand);
+    long c;
+    if (v->op_kind == UnaryOpValue::MINUS && constant(v->operand.get(), c))
+      replaceByNumber(*v, static_cast<int>(0u - static_cast<unsigned int>(c)));
+    else if (v->op_kind == UnaryOpValue::NOT &&
+             constant(v->operand.get(), c))
+      replaceByNumber(*v, c == 0);
+    else if (v->op_kind == UnaryOpValue::NOT) {
+      auto inner = dyn_cast<Unary>(v->operand);
+      if (inner && inner->op_kind == UnaryOpValue::NOT &&
+          boolean(inner->operand.get()))
+        replaceByOperand(*v, inner->operand);
+    }
+  }
+
+  /**
+   * the size is known after semantic analysis, operands aren't evaluated
+   *
+   * @param v visitor
+   */
+  void visitSizeOf(SizeOf *v) {
+    auto size = v->value(*table);
+    ASTNodeListType dead;
+    dead.push_back(std::move(v->type_name));
+    dead.push_back(std::move(v->operand));
+    destroyTree(std::move(dead));
+    replaceByNumber(*v, size);
+  }
+
+  /**
+   * fold arithmetic and comparisons of constants, logical operators with a
+   * constant left side and additions of 0 and multiplications with 1
+   *
+   * @param v visitor
+   */
+  void visitBinary(Binary *v) {
+    bool logical = v->op_kind == BinaryOpValue::LOGICAL_AND ||
+                   v->op_kind == BinaryOpValue::LOGICAL_OR;
+    if (logical) {
+      foldCondition(v->left_operand);
+      foldCondition(v->right_operand);
+    } else {
+      fold(v->left_operand);
+      fold(v->right_operand);
+    }
+    long l, r;
+    bool left = constant(v->left_operand.get(), l);
+    bool right = constant(v->right_operand.get(), r);
+    // arithmetic is done like codegen on 32 bit
+    auto ul = static_cast<unsigned int>(l);
+    auto ur = static_cast<unsigned int>(r);
+    switch (v->op_kind) {
+    case BinaryOpValue::MULTIPLY:
+      if (left && right)
+        replaceByNumber(*v, static_cast<int>(ul * ur));
+      else if (left && l == 1)
+        replaceByOperand(*v, v->right_operand);
+      else if (right && r == 1)
+        replaceByOperand(*v, v->left_operand);
+      break;
+    case BinaryOpValue::ADD:
+      if (left && right)
+        replaceByNumber(*v, static_cast<int>(ul + ur));
+      else if (left && l == 0)
+        replaceByOperand(*v, v->right_operand);
+      else if (right && r == 0)
+        replaceByOperand(*v, v->left_operand);
+      break;
+    case BinaryOpValue::SUBTRACT:
+      if (left && right)
+        replaceByNumber(*v, static_cast<int>(ul - ur));
+      else if (right && r == 0)
+        replaceByOperand(*v, v->left_operand);
+      break;
+    case BinaryOpValue::LESS_THAN:
+      if (left && right)
+        replaceByNumber(*v, l < r);
+      break;
+    case BinaryOpValue::EQUAL:
+      if (left && right)
+        replaceByNumber(*v, l == r);
+      break;
+    case BinaryOpValue::NOT_EQUAL:
+      if (left && right)
+        replaceByNumber(*v, l != r);
+      break;
+    case BinaryOpValue::LOGICAL_AND:
+      // the right side is evaluated only if the left one is true
+      if (left && (!l || right))
+        replaceByNumber(*v, l && r);
+      else if (left && boolean(v->right_operand.get()))
+        replaceByOperand(*v, v->right_operand);
+      break;
+    case BinaryOpValue::LOGICAL_OR:
+      if (left && (l || right))
+        replaceByNumber(*v, l || r);
+      else if (left && boolean(v->right_operand.get()))
+        replaceByOperand(*v, v->right_operand);
+      break;
+    case BinaryOpValue::ASSIGN:
+      break;
+    }
+  }
+
+  /**
+   * select the branch of a constant predicate
+   *
+   * @param v visitor
+   */
+  void visitTernary(Ternary *v) {
+    foldCondition(v->predicate);
+    fold(v->left_branch);
+    fold(v->right_branch);
+    long c;
+    if (constant(v->predicate.get(), c))
+      replaceByOperand(*v, c ? v->left_branch : v->right_branch);
+  }
+
+  /**
+   * @param v visitor
+   */
+  void visitAssignment(Assignment *v) {
+    fold(v->left_operand);
+    fold(v->right_operand);
+  }
+};
+} // namespace ccc
+
+#endif // C4_CONSTANT_FOLDING_VISITOR_HPP
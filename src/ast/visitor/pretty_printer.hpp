@@ -175,7 +175,7 @@ public:
     std::stringstream ss;
     std::string pre, post;
     if (v->return_ptr != nullptr) {
-      const auto &abstract = *v->return_ptr->getAbstractDeclarator();
+      const auto &abstract = *cast<AbstractDeclarator>(v->return_ptr);
       for (unsigned int i = 0; i < abstract.pointerCount; i++) {
         pre += "(*";
         post += ")";
@@ -305,6 +305,9 @@ public:
   std::string visitVariableName(VariableName *v) override { return v->name; }
 
   std::string visitNumber(Number *v) override {
+    // folded constants can be negative, print them like a parsed minus
+    if (v->num_value < 0)
+      return "(" + std::to_string(v->num_value) + ")";
     return std::to_string(v->num_value);
   }
 
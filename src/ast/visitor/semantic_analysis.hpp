@@ -1,26 +1,25 @@
 #include "../ast_node.hpp"
-#include <iterator>
+#include "../diagnostics.hpp"
+#include "../symbol_table.hpp"
+#include "../traversal.hpp"
+#include <deque>
 #include <sstream>
 
 namespace ccc {
 using ASTNodeListType = std::vector<std::unique_ptr<ASTNode>>;
-using ScopeListType = std::vector<std::unordered_set<std::string>>;
 using IdentifierSetType = std::unordered_set<std::string>;
 using IdentifierPtrListType = std::vector<std::unique_ptr<VariableName> *>;
-using IdentifierMapType =
-    std::unordered_map<std::string, std::shared_ptr<RawType>>;
 
 /**
  * AST visitor class for semantical analysis
  */
-class SemanticVisitor : public Visitor<std::string> {
+class SemanticVisitor : public StaticVisitor<SemanticVisitor, bool> {
   // save all occuring identifiers with type informations
-  IdentifierSetType definitions;
-  IdentifierMapType declarations;
+  SymbolTable symbols;
   IdentifierSetType labels;
   IdentifierPtrListType uLabels;
-  // global error string
-  std::string error;
+  // errors are recorded here and only formatted when printed
+  DiagnosticsEngine diagnostics;
   // detect nested loops
   int loop_counter;
   // passes between visits
@@ -28,508 +27,464 @@ class SemanticVisitor : public Visitor<std::string> {
   std::string alias;
   bool function_definition = false;
   // set by walking the tree bottom up, used to pass information to parent nodes
-  std::shared_ptr<RawType> raw_type = nullptr;
+  RawType *raw_type = nullptr;
   // return type of current function body
-  std::shared_ptr<RawType> jump_type = nullptr;
-  // prefixcode for identifiers
-  std::vector<std::string> pre;
+  RawType *jump_type = nullptr;
+  // parameters of the current function definition, bound in its body scope
+  bool keep_params = false;
+  bool function_body = false;
+  std::vector<unsigned int> params;
+  // annotations and types of the translation unit being analysed
+  SemanticTable *table = nullptr;
+  TypeContext *types = nullptr;
+  // results of type checks between compound types
+  CompatibilityCache compatibility;
+  // walks over the binary expressions being checked, one per nesting level,
+  // kept to reuse their memory, and the types of their operands
+  std::deque<PostOrderIterator> walks;
+  std::size_t walking = 0;
+  std::vector<RawType *> operands;
 
-  // generate prefix
-  std::string prefix() {
-    std::ostringstream os;
-    std::copy(pre.begin(), pre.end(),
-              std::ostream_iterator<std::string>(os, "."));
-    return os.str();
+  // operand is the number 0, looking through nested unary operators
+  static bool isNullConstant(Unary *v) {
+    Expression *e = v->operand.get();
+    while (isa<Unary>(e))
+      e = cast<Unary>(e)->operand.get();
+    return isa<Number>(e) && cast<Number>(e)->num_value == 0;
   }
 
-  std::string prefix(const std::string &s) { return prefix() + s; }
-
 public:
-  SemanticVisitor() : loop_counter(0), pre({"$"}) {}
+  SemanticVisitor() : loop_counter(0) {}
 
-  ~SemanticVisitor() override = default;
+  ~SemanticVisitor() = default;
 
   /**
-   * method to print current scopes at any point in analysis
+   * method to print all symbols at any point in analysis
    */
   void printScopes() {
     std::stringstream ss;
-    for (const auto &d : declarations)
-      ss << "  " << d.first << ":"
-         << "\033[31;m" << d.second->print() << "\033[0;m,\n";
-    std::cout << "[\n" << ss.str() << "]";
-    std::ostringstream os;
-    std::copy(definitions.begin(), definitions.end(),
-              std::ostream_iterator<std::string>(os, ", "));
-    std::cout << "{" << os.str() << "}";
-    std::cout << std::endl;
+    for (unsigned int i = 1; i < symbols.size(); i++)
+      ss << "  " << i << " " << symbols[i].name << ":"
+         << "\033[31;m"
+         << (symbols[i].type ? symbols[i].type->print() : "incomplete")
+         << "\033[0;m" << (symbols[i].defined ? " defined" : "") << ",\n";
+    std::cout << "[\n" << ss.str() << "]" << std::endl;
   }
 
   /**
-   * called externaly to check for errors - adressing undefined labels
+   * called externaly to check for errors
    *
    * @return bool
    */
-  bool fail() {
-    if (!error.empty())
-      return true;
-    for (const auto &l : uLabels) {
-      if (labels.find((*l)->name) == labels.end()) {
-        error = SEMANTIC_ERROR((*l)->getTokenRef().getLine(),
-                               (*l)->getTokenRef().getColumn(),
-                               "Use of undeclared label '" + (*l)->name + "'");
-        return true;
-      }
-    }
-    return false;
-  }
+  bool fail() { return !diagnostics.empty(); }
 
-  std::string getError() { return error; }
+  std::string getError() {
+    return diagnostics.empty() ? "" : diagnostics.format(0);
+  }
 
   /**
    * root of AST
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitTranslationUnit(TranslationUnit *v) override {
+  bool visitTranslationUnit(TranslationUnit *v) {
     raw_type = nullptr;
+    table = &v->table;
+    types = &v->types;
     for (const auto &child : v->extern_list) {
-      error = child->accept(this);
-      if (!error.empty())
-        break;
+      if (!child->accept(this))
+        return false;
     }
-    return error;
+    return true;
   }
 
   /**
    * analyse external declared method, only appears in global scope
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitFunctionDefinition(FunctionDefinition *v) override {
+  bool visitFunctionDefinition(FunctionDefinition *v) {
     function_definition = true;
     v->return_type->accept(this);
     // is not abstract
+    params.clear();
     if (v->fn_name && v->fn_name->getIdentifier()) {
       const auto &identifier = *v->fn_name->getIdentifier();
-      auto name = prefix(identifier->name);
-      pre.emplace_back(identifier->name);
-      error = v->fn_name->accept(this);
-      if (!error.empty())
-        return error;
+      keep_params = true;
+      auto ok = v->fn_name->accept(this);
+      keep_params = false;
+      if (!ok)
+        return false;
+      auto id = symbols.lookupLocal(identifier->name);
       // check for duplicates
-      if (definitions.find(name) != definitions.end())
-        return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                              identifier->getTokenRef().getColumn(),
-                              "Redefinition of '" + identifier->name + "'");
-      definitions.insert(name);
-      if (declarations.find(name) != declarations.end()) {
-        if (!declarations[name]->compare_exact(raw_type))
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name +
-                                    "' of type " + declarations[name]->print() +
-                                    " with differtent type " +
-                                    raw_type->print());
+      if (id && symbols[id].defined)
+        return diagnostics.error(identifier->getLocation(),
+                                 "Redefinition of '%0'", identifier->name);
+      if (id) {
+        if (!symbols[id].type->compare_exact(raw_type))
+          return diagnostics.error(
+              identifier->getLocation(),
+              "Redefinition of '%0' of type %1 with differtent type %2",
+              identifier->name, symbols[id].type, raw_type);
       } else
-        // set to global map
-        declarations[name] = raw_type;
+        // set to global scope
+        id = symbols.declare(identifier->name, raw_type);
+      symbols[id].defined = true;
       if (raw_type->isFunctionPointer())
-        return SEMANTIC_ERROR(v->fn_name->getTokenRef().getLine(),
-                              v->fn_name->getTokenRef().getColumn(),
-                              "Can't define " + raw_type->print());
+        return diagnostics.error(v->fn_name->getLocation(), "Can't define %0",
+                                 raw_type);
       // set variables used in code gernation
-      v->setUType(raw_type);
-      v->setUIdentifier(name);
+      table->setType(*v, raw_type);
+      table->setSymbol(*v, id);
       // set return type of function body
       jump_type = raw_type->get_return();
+      function_body = true;
     } else if (v->fn_name)
-      return SEMANTIC_ERROR(v->fn_name->getTokenRef().getLine(),
-                            v->fn_name->getTokenRef().getColumn(),
-                            "Missing identifier");
+      return diagnostics.error(v->fn_name->getLocation(), "Missing identifier");
     function_definition = false;
-    error = v->fn_body->accept(this);
-    // delete everything in body scope
-    for (auto it = declarations.begin(); it != declarations.end();)
-      if ((*it).first.compare(0, prefix("$").size(), prefix("$")) == 0)
-        declarations.erase(it++);
-      else
-        ++it;
-    pre.pop_back();
-    return error;
+    labels.clear();
+    uLabels.clear();
+    // body scope is closed by the compound statement
+    if (!v->fn_body->accept(this))
+      return false;
+    // labels are local to their function, so are jumps to them
+    for (const auto &l : uLabels) {
+      if (labels.find((*l)->name) == labels.end())
+        return diagnostics.error((*l)->getLocation(),
+                                 "Use of undeclared label '%0'", (*l)->name);
+    }
+    return true;
   }
 
   /**
    *  predeclaration of function, basicly as above
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitFunctionDeclaration(FunctionDeclaration *v) override {
+  bool visitFunctionDeclaration(FunctionDeclaration *v) {
     function_definition = false;
     v->return_type->accept(this);
     if (v->fn_name && v->fn_name->getIdentifier()) {
       const auto &identifier = *v->fn_name->getIdentifier();
-      auto name = prefix(identifier->name);
       v->fn_name->accept(this);
-      if (declarations.find(name) != declarations.end()) {
+      auto id = symbols.lookupLocal(identifier->name);
+      if (id) {
         // allow redefinition with same type
-        if (!declarations[name]->compare_exact(raw_type))
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name +
-                                    "' of type " + declarations[name]->print() +
-                                    " with differtent type " +
-                                    raw_type->print());
+        if (!symbols[id].type->compare_exact(raw_type))
+          return diagnostics.error(
+              identifier->getLocation(),
+              "Redefinition of '%0' of type %1 with differtent type %2",
+              identifier->name, symbols[id].type, raw_type);
       } else
-        declarations[name] = raw_type;
+        id = symbols.declare(identifier->name, raw_type);
       v->isFuncPtr = raw_type->isFunctionPointer();
-      v->setUType(raw_type);
-      v->setUIdentifier(name);
+      table->setType(*v, raw_type);
+      table->setSymbol(*v, id);
     } else
-      return SEMANTIC_ERROR(v->return_type->getTokenRef().getLine(),
-                            v->return_type->getTokenRef().getColumn(),
-                            "Declaration without declarator");
-    for (auto it = declarations.begin(); it != declarations.end();)
-      if ((*it).first.compare(0, prefix("$").size(), prefix("$")) == 0)
-        declarations.erase(it++);
-      else
-        ++it;
-    return error;
+      return diagnostics.error(v->return_type->getLocation(),
+                               "Declaration without declarator");
+    return diagnostics.empty();
   }
 
   /**
    * check declaration of identifier with type
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitDataDeclaration(DataDeclaration *v) override {
-    error = v->data_type->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitDataDeclaration(DataDeclaration *v) {
+    if (!v->data_type->accept(this))
+      return false;
     if (v->data_name && v->data_name->getIdentifier()) {
       const auto &identifier = *v->data_name->getIdentifier();
-      std::string name = prefix(identifier->name);
       v->data_name->accept(this);
-      if (declarations.find(name) != declarations.end()) {
+      auto id = symbols.lookupLocal(identifier->name);
+      if (id) {
         // not global
-        if (!(prefix() == "$."))
+        if (!symbols.isGlobal())
           // lookup redefinition
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name + "'");
+          return diagnostics.error(identifier->getLocation(),
+                                   "Redefinition of '%0'", identifier->name);
         // allow gloabl redefinition with same type
-        else if (!declarations[name]->compare_exact(raw_type))
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name +
-                                    "' of type " + declarations[name]->print() +
-                                    " with differtent type " +
-                                    raw_type->print());
+        else if (!symbols[id].type->compare_exact(raw_type))
+          return diagnostics.error(
+              identifier->getLocation(),
+              "Redefinition of '%0' of type %1 with differtent type %2",
+              identifier->name, symbols[id].type, raw_type);
       } else
-        declarations[name] = raw_type;
-      v->global = prefix() == "$.";
+        id = symbols.declare(identifier->name, raw_type);
+      v->global = symbols.isGlobal();
       // set variables used in code gernation
-      v->setUType(raw_type);
-      v->setUIdentifier(name);
+      table->setType(*v, raw_type);
+      table->setSymbol(*v, id);
     } else if (raw_type->getRawTypeValue() != RawTypeValue::STRUCT) {
-      return SEMANTIC_ERROR(v->data_type->getTokenRef().getLine(),
-                            v->data_type->getTokenRef().getColumn(),
-                            "Declaration without declarator");
+      return diagnostics.error(v->data_type->getLocation(),
+                               "Declaration without declarator");
     }
     if (raw_type->getRawTypeValue() == RawTypeValue::VOID && v->data_name)
-      return SEMANTIC_ERROR(v->data_name->getTokenRef().getLine(),
-                            v->data_name->getTokenRef().getColumn(),
-                            "Incomplete type");
-    return error;
+      return diagnostics.error(v->data_name->getLocation(), "Incomplete type");
+    return diagnostics.empty();
   }
 
   /**
    *  check struct and keep scoping (nested structure) information
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitStructDeclaration(StructDeclaration *v) override {
-    error = v->struct_type->accept(this);
+  bool visitStructDeclaration(StructDeclaration *v) {
+    if (!v->struct_type->accept(this))
+      return false;
     // type wasn't set yet
     bool anonymous = !raw_type;
-    if (!error.empty())
-      return error;
     if (v->struct_alias) {
       const auto &identifier = *v->struct_alias->getIdentifier();
-      std::string name = prefix(identifier->name);
-      if (anonymous)
-        raw_type = std::make_shared<RawStructType>(
-            "struct " + prefix("__" + prefix(identifier->name) + "__"));
+      if (anonymous) {
+        // nameless struct, members are found through a hidden tag
+        auto tag = symbols.create("struct <anonymous>", nullptr);
+        raw_type = types->createStruct("struct <anonymous>", tag);
+        symbols[tag].type = raw_type;
+      }
       auto tmp = raw_type;
-      // nameless struct, use alias as scoping information
-      if (anonymous && (*v->struct_type->getStructType()).is_definition) {
-        pre.emplace_back("__" + name + "__");
-        for (const auto &d : (*v->struct_type->getStructType()).member_list) {
-          error = d->accept(this);
-          if (!error.empty())
-            return error;
-          if (!d->getUType()->elem_size.empty())
-            tmp->elem_size.insert(tmp->elem_size.end(),
-                                  d->getUType()->elem_size.begin(),
-                                  d->getUType()->elem_size.end());
+      if (anonymous && cast<StructType>(v->struct_type)->is_definition) {
+        symbols.pushScope();
+        std::vector<int> elems;
+        for (const auto &d : cast<StructType>(v->struct_type)->member_list) {
+          if (!d->accept(this))
+            return false;
+          if (!table->getType(*d)->elem_size.empty())
+            elems.insert(elems.end(), table->getType(*d)->elem_size.begin(),
+                         table->getType(*d)->elem_size.end());
           else
-            tmp->elem_size.push_back(d->getUType()->size());
+            elems.push_back(table->getType(*d)->size());
         }
-        pre.pop_back();
+        cast<RawStructType>(tmp)->complete(std::move(elems));
+        symbols.popRecord(cast<RawStructType>(tmp)->getTag());
       }
       raw_type = tmp;
       v->struct_alias->accept(this);
-      if (declarations.find(name) != declarations.end()) {
+      auto id = symbols.lookupLocal(identifier->name);
+      if (id) {
         // not global or anonymous
-        if (!(prefix() == "$.") || anonymous)
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name + "'");
-        else if (!declarations[name]->compare_exact(raw_type))
-          return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                                identifier->getTokenRef().getColumn(),
-                                "Redefinition of '" + identifier->name +
-                                    "' of type " + declarations[name]->print() +
-                                    " with different type " +
-                                    raw_type->print());
+        if (!symbols.isGlobal() || anonymous)
+          return diagnostics.error(identifier->getLocation(),
+                                   "Redefinition of '%0'", identifier->name);
+        else if (!symbols[id].type->compare_exact(raw_type))
+          return diagnostics.error(
+              identifier->getLocation(),
+              "Redefinition of '%0' of type %1 with different type %2",
+              identifier->name, symbols[id].type, raw_type);
       } else
-        declarations[name] = raw_type;
+        symbols.declare(identifier->name, raw_type);
     } else if (anonymous) {
       // basic support for anonymous structs, flatmaps to current scope
-      for (const auto &d : (*v->struct_type->getStructType()).member_list) {
-        error = d->accept(this);
-        if (!error.empty())
-          return error;
+      for (const auto &d : cast<StructType>(v->struct_type)->member_list) {
+        if (!d->accept(this))
+          return false;
       }
     }
     // set variables used in code generation
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return diagnostics.empty();
   }
 
   /**
    * only appears in parameter list, works as declaration to body scope
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitParamDeclaration(ParamDeclaration *v) override {
+  bool visitParamDeclaration(ParamDeclaration *v) {
     if (function_definition && !v->param_name)
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Expected identifier");
+      return diagnostics.error(v->getLocation(), "Expected identifier");
     // allow nested function types without parameter names
     auto tmp = function_definition;
     function_definition = false;
     v->param_type->accept(this);
     if (v->param_name && v->param_name->getIdentifier()) {
       const auto &identifier = *v->param_name->getIdentifier();
-      std::string name = prefix(identifier->name);
-      if (declarations.find(name) != declarations.end())
-        return SEMANTIC_ERROR(identifier->getTokenRef().getLine(),
-                              identifier->getTokenRef().getColumn(),
-                              "Redefinition of '" + identifier->name + "'");
+      if (symbols.lookupLocal(identifier->name))
+        return diagnostics.error(identifier->getLocation(),
+                                 "Redefinition of '%0'", identifier->name);
       v->param_name->accept(this);
-      declarations[name] = raw_type;
-      v->setUType(raw_type);
-      (*v->param_name->getIdentifier())->setUIdentifier(name);
+      auto id = symbols.declare(identifier->name, raw_type);
+      table->setType(*v, raw_type);
+      table->setSymbol(*identifier, id);
     } else if (v->param_name)
       v->param_name->accept(this);
     if (raw_type->getRawTypeValue() == RawTypeValue::VOID && v->param_name)
-      return SEMANTIC_ERROR(v->param_name->getTokenRef().getLine(),
-                            v->param_name->getTokenRef().getColumn(),
-                            "Incomplete type");
+      return diagnostics.error(v->param_name->getLocation(), "Incomplete type");
     function_definition = tmp;
-    return error;
+    return diagnostics.empty();
   }
 
   /**
    * container for scalar types
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitScalarType(ScalarType *v) override {
+  bool visitScalarType(ScalarType *v) {
     switch (v->type_kind) {
     case ScalarTypeValue::VOID:
-      raw_type = make_unique<RawScalarType>(RawTypeValue::VOID);
+      raw_type = types->getScalar(RawTypeValue::VOID);
       break;
     case ScalarTypeValue::INT:
-      raw_type = make_unique<RawScalarType>(RawTypeValue::INT);
+      raw_type = types->getScalar(RawTypeValue::INT);
       break;
     case ScalarTypeValue::CHAR:
-      raw_type = make_unique<RawScalarType>(RawTypeValue::CHAR);
+      raw_type = types->getScalar(RawTypeValue::CHAR);
       break;
     }
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * container for struct types
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitStructType(StructType *v) override {
+  bool visitStructType(StructType *v) {
     // not nameless
     if (v->struct_name) {
-      raw_type = nullptr;
-      if (v->is_definition) {
-        // allow redefinitions in different scopes (gcc doesn't)
+      auto name = "struct " + v->struct_name->name;
+      // allow redefinitions in different scopes (gcc doesn't), a definition
+      // completes a declaration of the same scope
+      auto tag = v->is_definition ? symbols.lookupLocal(name)
+                                  : symbols.lookup(name);
+      if (tag) {
+        raw_type = symbols[tag].type;
+        v->elem_size = raw_type->elem_size;
       } else {
-        std::string tmp;
-        std::string tmp_pre = prefix();
-        while (tmp_pre.find('.') != std::string::npos) {
-          tmp_pre = tmp_pre.substr(0, tmp_pre.find_last_of('.'));
-          tmp = tmp_pre + ".__" + v->struct_name->name + "__";
-          if (declarations.find(tmp) != declarations.end()) {
-            raw_type = declarations.find(tmp)->second;
-            v->elem_size = raw_type->elem_size;
-            break;
-          }
-        }
-      }
-      // calculate unique name
-      auto name = prefix("__" + v->struct_name->name + "__");
-      if (!raw_type) {
-        raw_type = make_unique<RawStructType>(
-            "struct " + prefix("__" + v->struct_name->name + "__"));
-        declarations[name] = raw_type;
+        tag = symbols.declare(name, nullptr);
+        raw_type = types->createStruct(name, tag);
+        symbols[tag].type = raw_type;
       }
       auto ret = raw_type;
       if (v->is_definition) {
-        if (definitions.find(name) != definitions.end())
-          return SEMANTIC_ERROR(v->struct_name->getTokenRef().getLine(),
-                                v->struct_name->getTokenRef().getColumn(),
-                                "Redefinition of 'struct " +
-                                    v->struct_name->name + "'");
-        pre.push_back("__" + v->struct_name->name + "__");
+        if (symbols[tag].defined)
+          return diagnostics.error(v->struct_name->getLocation(),
+                                   "Redefinition of 'struct %0'",
+                                   v->struct_name->name);
+        symbols.pushScope();
         // used for saving sizeof members
         v->elem_size.clear();
         // define members of struct
         for (const auto &d : v->member_list) {
-          error = d->accept(this);
-          if (!error.empty())
-            return error;
-          if (!d->getUType()->elem_size.empty())
+          if (!d->accept(this))
+            return false;
+          if (!table->getType(*d)->elem_size.empty())
             v->elem_size.insert(v->elem_size.end(),
-                                d->getUType()->elem_size.begin(),
-                                d->getUType()->elem_size.end());
+                                table->getType(*d)->elem_size.begin(),
+                                table->getType(*d)->elem_size.end());
           else
-            v->elem_size.push_back(d->getUType()->size());
+            v->elem_size.push_back(table->getType(*d)->size());
         }
-        definitions.insert(name);
-        pre.pop_back();
+        symbols[tag].defined = true;
+        // keep members for accessing them through the struct type
+        symbols.popRecord(tag);
       }
       raw_type = ret;
-      raw_type->elem_size = v->elem_size;
-      v->setUType(raw_type);
+      // only a definition changes the layout, a reference just reads it
+      if (v->is_definition)
+        cast<RawStructType>(raw_type)->complete(v->elem_size);
+      table->setType(*v, raw_type);
     } else {
       // nameless struct type, exists only inside sizeof
-      if (prefix() != "$.") {
-        pre.emplace_back("__" + std::to_string(v->hash()) + "__");
+      if (!symbols.isGlobal()) {
+        symbols.pushScope();
         v->elem_size.clear();
         for (const auto &d : v->member_list) {
-          error = d->accept(this);
-          if (!error.empty())
-            return error;
-          if (!d->getUType()->elem_size.empty())
+          if (!d->accept(this))
+            return false;
+          if (!table->getType(*d)->elem_size.empty())
             v->elem_size.insert(v->elem_size.end(),
-                                d->getUType()->elem_size.begin(),
-                                d->getUType()->elem_size.end());
+                                table->getType(*d)->elem_size.begin(),
+                                table->getType(*d)->elem_size.end());
           else
-            v->elem_size.push_back(d->getUType()->size());
+            v->elem_size.push_back(table->getType(*d)->size());
         }
-        for (auto it = declarations.begin(); it != declarations.end();)
-          if ((*it).first.compare(0, prefix().size(), prefix()) == 0)
-            declarations.erase(it++);
-          else
-            ++it;
-        for (auto it = definitions.begin(); it != definitions.end();)
-          if ((*it).compare(0, prefix().size(), prefix()) == 0)
-            definitions.erase(it++);
-          else
-            ++it;
-        pre.pop_back();
-        raw_type = make_unique<RawStructType>("");
-        raw_type->elem_size = v->elem_size;
-        v->setUType(raw_type);
+        symbols.popScope();
+        auto record = types->createStruct("");
+        record->complete(v->elem_size);
+        table->setType(*v, record);
       }
       // return null to struct declaration
       raw_type = nullptr;
     }
-    return error;
+    return true;
   }
 
   /**
    * container for abstract types
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitAbstractType(AbstractType *v) override {
+  bool visitAbstractType(AbstractType *v) {
     v->type->accept(this);
     for (int i = 0; i < v->ptr_count; i++)
-      raw_type = make_unique<RawPointerType>(raw_type);
-    v->setUType(raw_type);
-    return error;
+      raw_type = types->getPointer(raw_type);
+    table->setType(*v, raw_type);
+    return diagnostics.empty();
   }
 
   /**
    * break recursive raw type generation
    *
-   * @return string
+   * @return bool
    */
-  std::string visitDirectDeclarator(DirectDeclarator *) override {
+  bool visitDirectDeclarator(DirectDeclarator *) {
     // EMPTY
-    return error;
+    return true;
   }
 
   /**
    * container for abstract declarators
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitAbstractDeclarator(AbstractDeclarator *v) override {
+  bool visitAbstractDeclarator(AbstractDeclarator *v) {
     for (unsigned int i = 0; i < v->pointerCount; i++)
-      raw_type = make_unique<RawPointerType>(raw_type);
-    v->setUType(raw_type);
-    return error;
+      raw_type = types->getPointer(raw_type);
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * container for pointer declarators
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitPointerDeclarator(PointerDeclarator *v) override {
+  bool visitPointerDeclarator(PointerDeclarator *v) {
     v->identifier->accept(this);
     for (int i = 0; i < v->indirection_level; i++)
-      raw_type = make_unique<RawPointerType>(raw_type);
-    v->setUType(raw_type);
-    return error;
+      raw_type = types->getPointer(raw_type);
+    table->setType(*v, raw_type);
+    return diagnostics.empty();
   }
 
   /**
    * container for method declarators
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitFunctionDeclarator(FunctionDeclarator *v) override {
-    // open a new scope for parameter list which will be kept for visiting body
-    pre.emplace_back("$");
-    v->identifier->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitFunctionDeclarator(FunctionDeclarator *v) {
+    // parameters of a definition are bound again in the body scope
+    auto keep = keep_params;
+    keep_params = false;
+    // open a new scope for parameter list
+    symbols.pushScope();
+    if (!v->identifier->accept(this))
+      return false;
     // wrapping function pointer - fixing an issue resulting from parsing
     // abstract return type instead of function pointer
     int lvl = 0;
@@ -537,32 +492,32 @@ public:
       raw_type = raw_type->deref();
       lvl++;
     }
-    v->return_ptr->accept(this);
-    if (!error.empty())
-      return error;
+    if (!v->return_ptr->accept(this))
+      return false;
     auto return_type = raw_type;
-    auto tmp = std::vector<std::shared_ptr<RawType>>();
+    auto tmp = std::vector<RawType *>();
     if (v->param_list.size() == 1 && !v->param_list[0]->param_name) {
-      error = v->param_list[0]->param_type->accept(this);
-      if (raw_type->compare_equal(
-              std::make_shared<RawScalarType>(RawTypeValue::VOID))) {
-        pre.pop_back();
-        raw_type = make_unique<RawFunctionType>(return_type, tmp);
+      if (!v->param_list[0]->param_type->accept(this))
+        return false;
+      if (raw_type->compare_equal(types->getScalar(RawTypeValue::VOID))) {
+        symbols.popScope();
+        raw_type = types->getFunction(return_type, tmp);
         for (int i = 0; i < lvl; i++)
-          raw_type = make_unique<RawPointerType>(raw_type);
-        return error;
+          raw_type = types->getPointer(raw_type);
+        return true;
       }
     }
     if (function_definition)
       function_definition =
           return_type->getRawTypeValue() != RawTypeValue::FUNCTION;
     for (const auto &p : v->param_list) {
-      error = p->accept(this);
-      if (!error.empty())
-        return error;
+      if (!p->accept(this))
+        return false;
       tmp.emplace_back(raw_type);
     }
-    pre.pop_back();
+    if (keep)
+      params = symbols.currentScope();
+    symbols.popScope();
     if (return_type->getRawTypeValue() == RawTypeValue::FUNCTION) {
       auto tmp_ret = return_type->get_return();
       auto tmp_param = return_type->get_param();
@@ -571,113 +526,80 @@ public:
         tmp_ret = tmp_ret->deref();
         lvl_p++;
       }
-      return_type = make_unique<RawFunctionType>(tmp_ret, tmp);
+      return_type = types->getFunction(tmp_ret, tmp);
       for (int i = 0; i < lvl_p; i++)
-        return_type = make_unique<RawPointerType>(return_type);
-      raw_type = make_unique<RawFunctionType>(return_type, tmp_param);
+        return_type = types->getPointer(return_type);
+      raw_type = types->getFunction(return_type, tmp_param);
     } else
-      raw_type = make_unique<RawFunctionType>(return_type, tmp);
+      raw_type = types->getFunction(return_type, tmp);
     // build function pointer
     for (int i = 0; i < lvl; i++)
-      raw_type = make_unique<RawPointerType>(raw_type);
-    return error;
+      raw_type = types->getPointer(raw_type);
+    return true;
   }
 
   /**
    * handle nested statements
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitCompoundStmt(CompoundStmt *v) override {
-    // open a new scope by pushing prefix
-    pre.emplace_back("$");
+  bool visitCompoundStmt(CompoundStmt *v) {
+    // open a new scope, a function body shares it with the parameters
+    symbols.pushScope();
+    if (function_body) {
+      function_body = false;
+      for (auto p : params)
+        symbols.bind(p);
+    }
     // visit all children
     for (const auto &stat : v->block_items) {
-      error = stat->accept(this);
-      if (!error.empty())
-        break;
+      if (!stat->accept(this))
+        return false;
     }
-    // delete all nested declarations and definitions
-    for (auto it = declarations.begin(); it != declarations.end();)
-      if ((*it).first.compare(0, prefix().size(), prefix()) == 0)
-        declarations.erase(it++);
-      else
-        ++it;
-    for (auto it = definitions.begin(); it != definitions.end();)
-      if ((*it).compare(0, prefix().size(), prefix()) == 0)
-        definitions.erase(it++);
-      else
-        ++it;
-    // pop prefix
-    pre.pop_back();
-    return error;
+    // drop all nested declarations and definitions
+    symbols.popScope();
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitIfElse(IfElse *v) override {
-    error = v->condition->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitIfElse(IfElse *v) {
+    if (!v->condition->accept(this))
+      return false;
     // insist on boolean value
-    if (!raw_type->compare_equal(
-            make_unique<RawScalarType>(RawTypeValue::INT))) {
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Condition has to be int, found " + raw_type->print());
+    if (!raw_type->compare_equal(types->getScalar(RawTypeValue::INT))) {
+      return diagnostics.error(v->getLocation(),
+                               "Condition has to be int, found %0", raw_type);
     }
     // if statemnt in own scope
-    pre.emplace_back("if");
-    error = v->ifStmt->accept(this);
-    if (!error.empty())
-      return error;
-    for (auto it = declarations.begin(); it != declarations.end();)
-      if ((*it).first.compare(0, prefix().size(), prefix()) == 0)
-        declarations.erase(it++);
-      else
-        ++it;
-    for (auto it = definitions.begin(); it != definitions.end();)
-      if ((*it).compare(0, prefix().size(), prefix()) == 0)
-        definitions.erase(it++);
-      else
-        ++it;
-    pre.pop_back();
+    symbols.pushScope();
+    if (!v->ifStmt->accept(this))
+      return false;
+    symbols.popScope();
     // else can be empty
     if (v->elseStmt) {
       // else statement in own scope
-      pre.emplace_back("else");
-      error = v->elseStmt->accept(this);
-      if (!error.empty())
-        return error;
-      for (auto it = declarations.begin(); it != declarations.end();)
-        if ((*it).first.compare(0, prefix().size(), prefix()) == 0)
-          declarations.erase(it++);
-        else
-          ++it;
-      for (auto it = definitions.begin(); it != definitions.end();)
-        if ((*it).compare(0, prefix().size(), prefix()) == 0)
-          definitions.erase(it++);
-        else
-          ++it;
-      pre.pop_back();
+      symbols.pushScope();
+      if (!v->elseStmt->accept(this))
+        return false;
+      symbols.popScope();
     }
-    return error;
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitLabel(Label *v) override {
+  bool visitLabel(Label *v) {
     auto label = v->label_name->name;
     for (const auto &l : labels) {
       if (l == label) {
-        return SEMANTIC_ERROR(v->label_name->getTokenRef().getLine(),
-                              v->label_name->getTokenRef().getColumn(),
-                              "Redefinition of label '" + label + "'");
+        return diagnostics.error(v->label_name->getLocation(),
+                                 "Redefinition of label '%0'", label);
       }
     }
     // keep label as defined
@@ -685,370 +607,316 @@ public:
     return v->stmt->accept(this);
   }
 
-  std::string visitWhile(While *v) override {
-    error = v->predicate->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitWhile(While *v) {
+    if (!v->predicate->accept(this))
+      return false;
     // insist on boolean value
-    if (!raw_type->compare_equal(
-            make_unique<RawScalarType>(RawTypeValue::INT))) {
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Predicate has to be int, found " + raw_type->print());
+    if (!raw_type->compare_equal(types->getScalar(RawTypeValue::INT))) {
+      return diagnostics.error(v->getLocation(),
+                               "Predicate has to be int, found %0", raw_type);
     }
     // keep track of nested loops
     loop_counter++;
     // insert own scope for lop body
-    pre.emplace_back("while");
-    error = v->block->accept(this);
+    symbols.pushScope();
+    auto ok = v->block->accept(this);
     loop_counter--;
-    for (auto it = declarations.begin(); it != declarations.end();)
-      if ((*it).first.compare(0, prefix().size(), prefix()) == 0)
-        declarations.erase(it++);
-      else
-        ++it;
-    for (auto it = definitions.begin(); it != definitions.end();)
-      if ((*it).compare(0, prefix().size(), prefix()) == 0)
-        definitions.erase(it++);
-      else
-        ++it;
-    pre.pop_back();
-    return error;
+    symbols.popScope();
+    return ok;
   }
 
   /**
    * check jump instruction
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitGoto(Goto *v) override {
+  bool visitGoto(Goto *v) {
     auto label = v->label_name->name;
     // lookup label definitions
     for (const auto &l : labels)
       if (l == label)
-        return error;
+        return true;
     // label wasn't defined yet, so keep it in mind for later
     uLabels.push_back(&v->label_name);
-    return error;
+    return true;
   }
 
   /**
    * wrapper for expressions as statements
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitExpressionStmt(ExpressionStmt *v) override {
+  bool visitExpressionStmt(ExpressionStmt *v) {
     if (v->expr)
       return v->expr->accept(this);
-    return error;
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitBreak(Break *v) override {
+  bool visitBreak(Break *v) {
     // not in a loop
     if (loop_counter <= 0)
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "'break' statement not in a loop statement");
-    return error;
+      return diagnostics.error(v->getLocation(),
+                               "'break' statement not in a loop statement");
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitReturn(Return *v) override {
+  bool visitReturn(Return *v) {
     // returns a value, which has to be of current return type
     if (v->expr) {
-      error = v->expr->accept(this);
-      if (!error.empty())
-        return error;
-      if (!raw_type->compare_equal(jump_type))
-        return SEMANTIC_ERROR(v->expr->getTokenRef().getLine(),
-                              v->expr->getTokenRef().getColumn(),
-                              "Can't return " + raw_type->print() +
-                                  " instead of " + jump_type->print());
-      return error;
+      if (!v->expr->accept(this))
+        return false;
+      if (!compatibility.compatible(raw_type, jump_type))
+        return diagnostics.error(v->expr->getLocation(),
+                                 "Can't return %0 instead of %1", raw_type,
+                                 jump_type);
+      return true;
     }
     if (jump_type->getRawTypeValue() != RawTypeValue::VOID)
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Can't return void instead of " + jump_type->print());
-    return error;
+      return diagnostics.error(v->getLocation(),
+                               "Can't return void instead of %0", jump_type);
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitContinue(Continue *v) override {
+  bool visitContinue(Continue *v) {
     // not in a loop
     if (loop_counter <= 0)
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "'continue' statement not in a loop statement");
-    return error;
+      return diagnostics.error(v->getLocation(),
+                               "'continue' statement not in a loop statement");
+    return true;
   }
 
   /**
    * visit identifier, only called inside of expressions
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitVariableName(VariableName *v) override {
+  bool visitVariableName(VariableName *v) {
     temporary = false;
-    // find identifier in declarations / outer scopes
-    std::string name;
-    std::string tmp_pre = prefix();
-    while (tmp_pre.find('.') != std::string::npos) {
-      tmp_pre = tmp_pre.substr(0, tmp_pre.find_last_of('.'));
-      name = tmp_pre + "." + v->name;
-      if (declarations.find(name) != declarations.end()) {
-        raw_type = declarations[name];
-        v->setUIdentifier(name);
-        v->setUType(raw_type);
-        return error;
-      }
+    // find identifier in innermost scope declaring it
+    if (auto id = symbols.lookup(v->name)) {
+      raw_type = symbols[id].type;
+      table->setSymbol(*v, id);
+      table->setType(*v, raw_type);
+      return true;
     }
-    return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                          v->getTokenRef().getColumn(),
-                          "Use of undeclared identifier '" + name + "'");
+    return diagnostics.error(v->getLocation(),
+                             "Use of undeclared identifier '%0'", v->name);
   }
 
   /**
    * constant
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitNumber(Number *v) override {
+  bool visitNumber(Number *v) {
     temporary = v->num_value != 0;
     // use nil type to represent either nullptr or actual number 0
     if (v->num_value == 0)
-      raw_type = make_unique<RawScalarType>(RawTypeValue::NIL);
+      raw_type = types->getScalar(RawTypeValue::NIL);
     else
-      raw_type = make_unique<RawScalarType>(RawTypeValue::INT);
-    v->setUType(raw_type);
-    return error;
+      raw_type = types->getScalar(RawTypeValue::INT);
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * constant
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitCharacter(Character *v) override {
+  bool visitCharacter(Character *v) {
     temporary = true;
-    raw_type = make_unique<RawScalarType>(RawTypeValue::INT);
-    v->setUType(raw_type);
-    return error;
+    raw_type = types->getScalar(RawTypeValue::INT);
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * string literal
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitString(String *v) override {
+  bool visitString(String *v) {
     temporary = false;
-    raw_type = make_unique<RawPointerType>(
-        make_unique<RawScalarType>(RawTypeValue::CHAR));
-    v->setUType(raw_type);
-    return error;
+    raw_type = types->getPointer(types->getScalar(RawTypeValue::CHAR));
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * accesing members of a struct
    *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitMemberAccessOp(MemberAccessOp *v) override {
-    error = v->struct_name->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitMemberAccessOp(MemberAccessOp *v) {
+    if (!v->struct_name->accept(this))
+      return false;
     temporary = false;
     std::string sub;
     switch (v->op_kind) {
     case PostFixOpValue::ARROW: {
       // callee has to be pointer to struct
       if (raw_type->getRawTypeValue() != RawTypeValue::POINTER)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't dereference " + raw_type->print());
+        return diagnostics.error(v->getLocation(), "Can't dereference %0",
+                                 raw_type);
       if (raw_type->deref()->getRawTypeValue() != RawTypeValue::STRUCT)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't access member of " + raw_type->print());
+        return diagnostics.error(v->getLocation(), "Can't access member of %0",
+                                 raw_type);
       // find member
-      sub = raw_type->deref()->getRawStructType()->getName();
-      std::string name = sub.substr(7, sub.size()) + "." +
-                         v->member_name->getVariableName()->name;
-      if (declarations.find(name) != declarations.end()) {
-        raw_type = declarations[name];
+      auto record = cast<RawStructType>(raw_type->deref());
+      sub = record->getName();
+      auto id = symbols.lookupMember(record->getTag(),
+                                     cast<VariableName>(v->member_name)->name);
+      if (id) {
+        raw_type = symbols[id].type;
         // enable function pointer access without dereferencing
         if (raw_type->isFunctionPointer())
           while (raw_type->getRawTypeValue() == RawTypeValue::POINTER)
             raw_type = raw_type->deref();
-        v->setUType(raw_type);
-        return error;
+        table->setType(*v, raw_type);
+        return true;
       }
       break;
     }
     case PostFixOpValue::DOT:
       // callee has to be struct
       if (raw_type->getRawTypeValue() != RawTypeValue::STRUCT)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't access member of " + raw_type->print());
+        return diagnostics.error(v->getLocation(), "Can't access member of %0",
+                                 raw_type);
       // find member
-      sub = raw_type->getRawStructType()->getName();
-      std::string name = sub.substr(7, sub.size()) + "." +
-                         v->member_name->getVariableName()->name;
-      if (declarations.find(name) != declarations.end()) {
-        raw_type = declarations[name];
+      auto record = cast<RawStructType>(raw_type);
+      sub = record->getName();
+      auto id = symbols.lookupMember(record->getTag(),
+                                     cast<VariableName>(v->member_name)->name);
+      if (id) {
+        raw_type = symbols[id].type;
         // enable function pointer access without dereferencing
         if (raw_type->isFunctionPointer())
           while (raw_type->getRawTypeValue() == RawTypeValue::POINTER)
             raw_type = raw_type->deref();
-        v->setUType(raw_type);
-        return error;
+        table->setType(*v, raw_type);
+        return true;
       }
       break;
     }
-    return SEMANTIC_ERROR(
-        v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-        "Can't find member " + v->member_name->getVariableName()->name +
-            " of " + sub);
+    return diagnostics.error(v->getLocation(), "Can't find member %0 of %1",
+                             cast<VariableName>(v->member_name)->name, sub);
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitArraySubscriptOp(ArraySubscriptOp *v) override {
-    error = v->array_name->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitArraySubscriptOp(ArraySubscriptOp *v) {
+    if (!v->array_name->accept(this))
+      return false;
     auto lhs_type = raw_type;
-    error = v->index_value->accept(this);
-    if (!error.empty())
-      return error;
+    if (!v->index_value->accept(this))
+      return false;
     auto rhs_type = raw_type;
     // either lhs or rhs have to be pointer and index value
     if (lhs_type->getRawTypeValue() == RawTypeValue::POINTER) {
-      if (!rhs_type->compare_equal(
-              make_unique<RawScalarType>(RawTypeValue::INT)))
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't index with " + rhs_type->print());
+      if (!rhs_type->compare_equal(types->getScalar(RawTypeValue::INT)))
+        return diagnostics.error(v->getLocation(), "Can't index with %0",
+                                 rhs_type);
       raw_type = lhs_type->deref();
-    } else if (rhs_type->compare_equal(
-                   make_unique<RawScalarType>(RawTypeValue::INT))) {
+    } else if (rhs_type->compare_equal(types->getScalar(RawTypeValue::INT))) {
       if (rhs_type->getRawTypeValue() != RawTypeValue::POINTER)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't subscript " + rhs_type->print());
+        return diagnostics.error(v->getLocation(), "Can't subscript %0",
+                                 rhs_type);
       raw_type = rhs_type->deref();
     } else {
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Can't subscript " + lhs_type->print() + " with " +
-                                rhs_type->print());
+      return diagnostics.error(v->getLocation(), "Can't subscript %0 with %1",
+                               lhs_type, rhs_type);
     }
     temporary = false;
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitFunctionCall(FunctionCall *v) override {
-    error = v->callee_name->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitFunctionCall(FunctionCall *v) {
+    if (!v->callee_name->accept(this))
+      return false;
     if (raw_type->isFunctionPointer())
       raw_type = raw_type->deref();
     // callee has to be function
     if (raw_type->getRawTypeValue() != RawTypeValue::FUNCTION)
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Can't call " + raw_type->print());
+      return diagnostics.error(v->getLocation(), "Can't call %0", raw_type);
     auto return_type = raw_type;
     auto calle_arg_types = raw_type->get_param();
     // wrong number of arguments
     if (calle_arg_types.size() < v->callee_args.size())
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Too many arguments for " + return_type->print());
+      return diagnostics.error(v->getLocation(), "Too many arguments for %0",
+                               return_type);
     // compare passed values to expected arguments
     for (unsigned int i = 0; i < calle_arg_types.size(); i++) {
       if (i >= v->callee_args.size())
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Too few arguments for " + return_type->print());
-      error = v->callee_args[i]->accept(this);
-      if (!error.empty())
-        return error;
-      v->callee_args[i]->setUType(calle_arg_types[i]);
+        return diagnostics.error(v->getLocation(), "Too few arguments for %0",
+                                 return_type);
+      if (!v->callee_args[i]->accept(this))
+        return false;
+      table->setType(*v->callee_args[i], calle_arg_types[i]);
       if (calle_arg_types[i]->getRawTypeValue() != RawTypeValue::VOID &&
-          !calle_arg_types[i]->compare_equal(raw_type))
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't call " + calle_arg_types[i]->print() +
-                                  " with " + raw_type->print());
+          !compatibility.compatible(calle_arg_types[i], raw_type))
+        return diagnostics.error(v->getLocation(), "Can't call %0 with %1",
+                                 calle_arg_types[i], raw_type);
     }
     // pass back return type
     raw_type = return_type->get_return();
-    v->setUType(raw_type);
+    table->setType(*v, raw_type);
     temporary = true;
-    return error;
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitUnary(Unary *v) override {
+  bool visitUnary(Unary *v) {
     temporary = true;
-    error = v->operand->accept(this);
-    if (!error.empty())
-      return error;
+    if (!v->operand->accept(this))
+      return false;
     //    }
     switch (v->op_kind) {
     case UnaryOpValue::MINUS:
       // only applicable on numbers
-      if (!raw_type->compare_equal(
-              make_unique<RawScalarType>(RawTypeValue::INT)))
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't minus " + raw_type->print());
+      if (!raw_type->compare_equal(types->getScalar(RawTypeValue::INT)))
+        return diagnostics.error(v->getLocation(), "Can't minus %0", raw_type);
       temporary = true;
       break;
     case UnaryOpValue::NOT:
       // only applicable on boolean values
-      if (!raw_type->compare_equal(
-              make_unique<RawScalarType>(RawTypeValue::INT)))
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't negate " + raw_type->print());
+      if (!raw_type->compare_equal(types->getScalar(RawTypeValue::INT)))
+        return diagnostics.error(v->getLocation(), "Can't negate %0", raw_type);
       temporary = true;
       break;
     case UnaryOpValue::DEREFERENCE:
       // represent nullptr as void*
-      if (v->getNumber() && v->getNumber()->num_value == 0) {
-        raw_type = std::make_shared<RawPointerType>(
-            std::make_shared<RawScalarType>(RawTypeValue::VOID));
+      if (isNullConstant(v)) {
+        raw_type = types->getPointer(types->getScalar(RawTypeValue::VOID));
         break;
       }
       // dereference only pointer, value is not temporary
@@ -1057,63 +925,89 @@ public:
         break;
       }
       if (raw_type->getRawTypeValue() != RawTypeValue::POINTER)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't dereference " + raw_type->print());
+        return diagnostics.error(v->getLocation(), "Can't dereference %0",
+                                 raw_type);
       raw_type = raw_type->deref();
       temporary = false;
       break;
     case UnaryOpValue::ADDRESS_OF:
       // represent &0 as void
-      if (v->getNumber() && v->getNumber()->num_value == 0) {
-        raw_type = std::make_shared<RawScalarType>(RawTypeValue::VOID);
+      if (isNullConstant(v)) {
+        raw_type = types->getScalar(RawTypeValue::VOID);
       }
       // create pointer to value, which is temporary
-      raw_type = make_unique<RawPointerType>(raw_type);
+      raw_type = types->getPointer(raw_type);
       if (temporary)
-        return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                              v->getTokenRef().getColumn(),
-                              "Can't get address of temporay object");
+        return diagnostics.error(v->getLocation(),
+                                 "Can't get address of temporay object");
       temporary = true;
       break;
     }
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitSizeOf(SizeOf *v) override {
+  bool visitSizeOf(SizeOf *v) {
     // either expression or type
     if (v->operand) {
-      error = v->operand->accept(this);
+      if (!v->operand->accept(this))
+        return false;
     } else if (v->type_name) {
-      error = v->type_name->accept(this);
+      if (!v->type_name->accept(this))
+        return false;
     }
-    if (!error.empty())
-      return error;
     temporary = true;
     // return integer value
-    raw_type = make_unique<RawScalarType>(RawTypeValue::INT);
-    v->setUType(raw_type);
-    return error;
+    raw_type = types->getScalar(RawTypeValue::INT);
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
+   * nested binary operators are checked bottom up by a PostOrderIterator
+   * instead of recursing, so long chains like 1 + 1 + ... + 1 don't exhaust
+   * the stack - every other operand is visited as usual
+   *
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitBinary(Binary *v) override {
-    error = v->left_operand->accept(this);
-    if (!error.empty())
-      return error;
-    auto lhs_type = raw_type;
-    error = v->right_operand->accept(this);
-    if (!error.empty())
-      return error;
-    auto rhs_type = raw_type;
+  bool visitBinary(Binary *v) {
+    // operands can contain binary expressions again, which get their own walk
+    if (walking == walks.size())
+      walks.emplace_back(nullptr, [](ASTNode *n) { return isa<Binary>(n); });
+    auto &it = walks[walking++];
+    it.reset(v);
+    // types of the operands not yet combined are pushed above base
+    auto base = operands.size();
+    auto ok = true;
+    while (ok) {
+      auto n = it.next();
+      if (!n)
+        break;
+      if (auto b = dyn_cast<Binary>(n)) {
+        auto rhs_type = operands.back();
+        operands.pop_back();
+        ok = checkBinary(b, operands.back(), rhs_type);
+        operands.back() = raw_type;
+      } else if ((ok = n->accept(this)))
+        operands.push_back(raw_type);
+    }
+    operands.resize(base);
+    walking--;
+    return ok;
+  }
+
+  /**
+   * @param v binary operator
+   * @param lhs_type type of the left operand
+   * @param rhs_type type of the right operand
+   * @return bool
+   */
+  bool checkBinary(Binary *v, RawType *lhs_type, RawType *rhs_type) {
     // enforce restrictions on multiplication
     if (v->op_kind == BinaryOpValue::MULTIPLY &&
         ((lhs_type->getRawTypeValue() != RawTypeValue::INT &&
@@ -1122,31 +1016,26 @@ public:
          (rhs_type->getRawTypeValue() != RawTypeValue::INT &&
           rhs_type->getRawTypeValue() != RawTypeValue::CHAR &&
           rhs_type->getRawTypeValue() != RawTypeValue::NIL)))
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Can't handle " + lhs_type->print() + " * " + rhs_type->print());
+      return diagnostics.error(v->getLocation(), "Can't handle %0 * %1",
+                               lhs_type, rhs_type);
     // can't handle void
     if (lhs_type->getRawTypeValue() == RawTypeValue::VOID)
-      return SEMANTIC_ERROR(v->left_operand->getTokenRef().getLine(),
-                            v->left_operand->getTokenRef().getColumn(),
-                            "handling " + lhs_type->print());
+      return diagnostics.error(v->left_operand->getLocation(), "handling %0",
+                               lhs_type);
     if (rhs_type->getRawTypeValue() == RawTypeValue::VOID)
-      return SEMANTIC_ERROR(v->right_operand->getTokenRef().getLine(),
-                            v->right_operand->getTokenRef().getColumn(),
-                            "handling " + rhs_type->print());
+      return diagnostics.error(v->right_operand->getLocation(), "handling %0",
+                               rhs_type);
     // need to be able to cast both sides into each other
-    if (!lhs_type->compare_equal(rhs_type)) {
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Can't handle " + lhs_type->print() + " and " + rhs_type->print());
+    if (!compatibility.compatible(lhs_type, rhs_type)) {
+      return diagnostics.error(v->getLocation(), "Can't handle %0 and %1",
+                               lhs_type, rhs_type);
     }
     // pointer arithmetic
     if (lhs_type->getRawTypeValue() == RawTypeValue::POINTER &&
         rhs_type->getRawTypeValue() == RawTypeValue::POINTER &&
         !lhs_type->compare_exact(rhs_type))
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Can't handle " + lhs_type->print() + " and " + rhs_type->print());
+      return diagnostics.error(v->getLocation(), "Can't handle %0 and %1",
+                               lhs_type, rhs_type);
     temporary = true;
     // cast int and char
     if ((v->op_kind == BinaryOpValue::MULTIPLY ||
@@ -1154,21 +1043,19 @@ public:
          v->op_kind == BinaryOpValue::SUBTRACT) &&
         lhs_type->getRawTypeValue() == RawTypeValue::CHAR &&
         rhs_type->getRawTypeValue() == RawTypeValue::CHAR)
-      raw_type = std::make_shared<RawScalarType>(RawTypeValue::CHAR);
+      raw_type = types->getScalar(RawTypeValue::CHAR);
     else
-      raw_type = std::make_shared<RawScalarType>(RawTypeValue::INT);
+      raw_type = types->getScalar(RawTypeValue::INT);
     // pointer arithmetic 2.0, result not temporary
     if (v->op_kind == BinaryOpValue::ADD ||
         v->op_kind == BinaryOpValue::SUBTRACT) {
       if (lhs_type->getRawTypeValue() == RawTypeValue::POINTER &&
           rhs_type->getRawTypeValue() == RawTypeValue::POINTER) {
         if (v->op_kind == BinaryOpValue::ADD)
-          return SEMANTIC_ERROR(
-              v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-              "Can't handle " + lhs_type->print() + " + " + rhs_type->print());
+          return diagnostics.error(v->getLocation(), "Can't handle %0 + %1",
+                                   lhs_type, rhs_type);
         // ptrdiff
-        raw_type = std::make_shared<RawScalarType>(RawTypeValue::INT);
-        raw_type->setSize(8);
+        raw_type = types->getPtrDiff();
       } else if (rhs_type->getRawTypeValue() == RawTypeValue::POINTER) {
         raw_type = rhs_type;
         temporary = false;
@@ -1177,74 +1064,63 @@ public:
         temporary = false;
       }
     }
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitTernary(Ternary *v) override {
-    error = v->predicate->accept(this);
-    if (!error.empty())
-      return error;
-    if (!raw_type->compare_equal(
-            make_unique<RawScalarType>(RawTypeValue::INT))) {
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Predicate has to be int, found " + raw_type->print());
+  bool visitTernary(Ternary *v) {
+    if (!v->predicate->accept(this))
+      return false;
+    if (!raw_type->compare_equal(types->getScalar(RawTypeValue::INT))) {
+      return diagnostics.error(v->getLocation(),
+                               "Predicate has to be int, found %0", raw_type);
     }
-    error = v->left_branch->accept(this);
-    if (!error.empty())
-      return error;
+    if (!v->left_branch->accept(this))
+      return false;
     auto lhs_type = raw_type;
-    error = v->right_branch->accept(this);
-    if (!error.empty())
-      return error;
+    if (!v->right_branch->accept(this))
+      return false;
     auto rhs_type = raw_type;
     // branches have to have castable type
-    if (!lhs_type->compare_equal(rhs_type)) {
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Can't branch with " + lhs_type->print() + " and " +
-                                rhs_type->print());
+    if (!compatibility.compatible(lhs_type, rhs_type)) {
+      return diagnostics.error(v->getLocation(), "Can't branch with %0 and %1",
+                               lhs_type, rhs_type);
     }
     // result is temporary
     temporary = true;
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 
   /**
    * @param v visitor
-   * @return string
+   * @return bool
    */
-  std::string visitAssignment(Assignment *v) override {
-    error = v->left_operand->accept(this);
-    if (!error.empty())
-      return error;
+  bool visitAssignment(Assignment *v) {
+    if (!v->left_operand->accept(this))
+      return false;
     auto lhs_type = raw_type;
     // lhs has to be non temporary lvalue
     if (temporary || !v->left_operand->isLValue() ||
         lhs_type->getRawTypeValue() == RawTypeValue::FUNCTION)
-      return SEMANTIC_ERROR(v->getTokenRef().getLine(),
-                            v->getTokenRef().getColumn(),
-                            "Can't assign to " + lhs_type->print());
-    error = v->right_operand->accept(this);
-    if (!error.empty())
-      return error;
+      return diagnostics.error(v->getLocation(), "Can't assign to %0",
+                               lhs_type);
+    if (!v->right_operand->accept(this))
+      return false;
     auto rhs_type = raw_type;
     // rhs has to be cast into lhs
-    if (!lhs_type->compare_equal(rhs_type)) {
-      return SEMANTIC_ERROR(
-          v->getTokenRef().getLine(), v->getTokenRef().getColumn(),
-          "Can't assign " + rhs_type->print() + " to " + lhs_type->print());
+    if (!compatibility.compatible(lhs_type, rhs_type)) {
+      return diagnostics.error(v->getLocation(), "Can't assign %0 to %1",
+                               rhs_type, lhs_type);
     }
     // pass rhs as result, which is temporary
     temporary = true;
-    v->setUType(raw_type);
-    return error;
+    table->setType(*v, raw_type);
+    return true;
   }
 };
 } // namespace ccc
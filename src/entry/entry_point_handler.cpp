@@ -1,9 +1,12 @@
 #include "entry_point_handler.hpp"
 #include "../ast/visitor/codegen.hpp"
+#include "../ast/visitor/constant_folding.hpp"
 #include "../ast/visitor/graphviz.hpp"
 #include "../ast/visitor/semantic_analysis.hpp"
 #include "../lexer/fast_lexer.hpp"
 #include "../parser/fast_parser.hpp"
+#include <algorithm>
+#include <thread>
 
 #define PARSE                                                                  \
   auto parser = FastParser(buffer, path);                                      \
@@ -19,10 +22,37 @@
     std::cerr << path << ":" << sv.getError() << std::endl;                    \
     return EXIT_FAILURE;                                                       \
   }
+#define FOLD                                                                   \
+  ConstantFoldingVisitor fv;                                                   \
+  root->accept(&fv);
 #define COMPILE                                                                \
   CodegenVisitor cv(path);                                                     \
+  if (!output.empty())                                                         \
+    cv.setOutput(output);                                                      \
+  if (generate)                                                                \
+    cv.setProfileGenerate(profileName(path));                                  \
+  if (!use.empty() && !cv.setProfileUse(use)) {                                \
+    std::cerr << "can't read profile " << use << std::endl;                    \
+    return EXIT_FAILURE;                                                       \
+  }                                                                            \
+  if ((emit == "--emit-obj" || emit == "--emit-asm" || flag == "--run") &&     \
+      !cv.setTarget(level, fast))                                              \
+    return EXIT_FAILURE;                                                       \
   root->accept(&cv);                                                           \
-  cv.compile();
+  if (fast)                                                                    \
+    cv.optimizeCompileTime();                                                  \
+  else if ((level > 0 || size > 0) && !cv.optimize(level, size))               \
+    return EXIT_FAILURE;                                                       \
+  if (flag == "--run")                                                         \
+    return cv.run();                                                           \
+  if (emit.empty() && !cv.compile(!fast))                                      \
+    return EXIT_FAILURE;                                                       \
+  if (emit == "--emit-bc" && !cv.emitBitcode())                                \
+    return EXIT_FAILURE;                                                       \
+  if ((emit == "--emit-obj" || emit == "--emit-asm") &&                        \
+      !cv.emit(emit == "--emit-asm" ? llvm::TargetMachine::CGFT_AssemblyFile   \
+                                    : llvm::TargetMachine::CGFT_ObjectFile))   \
+    return EXIT_FAILURE;
 #define HELP                                                                   \
   std::cout                                                                    \
       << "Usage: c4 [options] file\n"                                          \
@@ -36,67 +66,253 @@
          "  --graphviz                like --parse but print graphviz "        \
          "representation of AST\n"                                             \
          "  --compile                 compile to LLVM IR\n"                    \
-         "  --optimize                WIP\n"                                   \
-         "  --optimize-run-time       WIP\n"                                   \
-         "  --optimize-compile-time   WIP\n"                                   \
+         "  --optimize                compile to optimized LLVM IR, -O2 if "   \
+         "no level is given\n"                                                 \
+         "  --optimize-run-time       like --optimize with -O3\n"              \
+         "  --optimize-compile-time   only promote to registers and simplify " \
+         "control flow, skip verification\n"                                   \
+         "  --emit-obj                like --compile but write a native "      \
+         "object file\n"                                                       \
+         "  --emit-asm                like --compile but write native "        \
+         "assembly\n"                                                          \
+         "  --emit-bc                 like --compile but write LLVM bitcode\n" \
+         "  --run                     compile just in time and run main, "     \
+         "exit with its result\n"                                              \
+         "  -O0 -O1 -O2 -O3 -Os -Oz   optimization level\n"                    \
+         "  -o file                   write output of compilation to file\n"   \
+         "  --profile-generate        count executed branches, the program "   \
+         "writes them to file.prof at exit\n"                                  \
+         "  --profile-use=profile     optimize for the branch counts of a "    \
+         "profile\n"                                                           \
+         "  --jobs=n                  with --emit-obj or --emit-asm, split "   \
+         "the functions into n files\n"                                        \
+         "                            file.0.o to file.n-1.o generated in "    \
+         "parallel\n"                                                          \
       << std::endl;
 namespace ccc {
 EntryPointHandler::EntryPointHandler() = default;
 
+/**
+ * read an optimization level like -O2 or -Os
+ *
+ * @param arg command line argument
+ * @param level set to the level of speed optimizations
+ * @param size set to the level of size optimizations
+ * @return false if arg is no optimization level
+ */
+static bool parseLevel(const std::string &arg, unsigned int &level,
+                       unsigned int &size) {
+  if (arg.size() != 3 || arg.compare(0, 2, "-O") != 0)
+    return false;
+  if (arg[2] >= '0' && arg[2] <= '3') {
+    level = static_cast<unsigned int>(arg[2] - '0');
+    size = 0;
+  } else if (arg[2] == 's' || arg[2] == 'z') {
+    level = 2;
+    size = arg[2] == 's' ? 1 : 2;
+  } else
+    return false;
+  return true;
+}
+
+/**
+ * read a positive number like the n of --jobs=n
+ *
+ * @param arg digits
+ * @param n set to the number
+ * @return false if arg is no number from 1 to 9999
+ */
+static bool parseCount(const std::string &arg, unsigned int &n) {
+  if (arg.empty() || arg.size() > 4 ||
+      arg.find_first_not_of("0123456789") != std::string::npos)
+    return false;
+  n = static_cast<unsigned int>(std::stoul(arg));
+  return n > 0;
+}
+
+/**
+ * @param arg command line argument
+ * @return if arg selects what to do with the input file
+ */
+static bool isMode(const std::string &arg) {
+  static const char *modes[] = {
+      "--tokenize", "--parse", "--print-ast", "--graphviz", "--compile",
+      "--optimize", "--optimize-run-time", "--optimize-compile-time", "--run"};
+  return std::find(std::begin(modes), std::end(modes), arg) !=
+         std::end(modes);
+}
+
+/**
+ * @param path input file
+ * @return name of the input file with the extension ".prof" instead of ".c"
+ */
+static std::string profileName(const std::string &path) {
+  auto name = path.substr(path.rfind('/') + 1);
+  return name.substr(0, name.rfind(".c")) + ".prof";
+}
+
+/**
+ * generate native code in one file per shard of the function definitions,
+ * each shard on its own thread - linked together the files behave like a
+ * single object, only calls between shards can't be inlined
+ *
+ * @param root analysed and folded translation unit
+ * @param path input file
+ * @param output path given with -o, numbered per shard
+ * @param use profile of --profile-use
+ * @param jobs number of shards
+ * @param level optimization level
+ * @param size size optimization level
+ * @param fast cheap pipeline of --optimize-compile-time
+ * @param type object file or assembly
+ * @return false if a shard could not be generated or written
+ */
+static bool emitShards(ASTNode *root, const std::string &path,
+                       const std::string &output, const std::string &use,
+                       unsigned int jobs, unsigned int level, unsigned int size,
+                       bool fast, llvm::TargetMachine::CodeGenFileType type) {
+  std::vector<std::unique_ptr<CodegenVisitor>> shards;
+  for (unsigned int i = 0; i < jobs; i++) {
+    shards.push_back(make_unique<CodegenVisitor>(path));
+    auto &cv = *shards.back();
+    cv.setShard(i, jobs);
+    if (!output.empty())
+      cv.setOutput(output);
+    if (!use.empty() && !cv.setProfileUse(use)) {
+      std::cerr << "can't read profile " << use << std::endl;
+      return false;
+    }
+    // registers the targets, which isn't thread safe
+    if (!cv.setTarget(level, fast))
+      return false;
+  }
+  // every shard only touches its own context, the AST is just read
+  std::vector<char> done(jobs, 0);
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < jobs; i++)
+    threads.emplace_back([&, i]() {
+      auto &cv = *shards[i];
+      root->accept(&cv);
+      if (fast)
+        cv.optimizeCompileTime();
+      else if ((level > 0 || size > 0) && !cv.optimize(level, size))
+        return;
+      done[i] = cv.emit(type);
+    });
+  for (auto &t : threads)
+    t.join();
+  return std::find(done.begin(), done.end(), 0) == done.end();
+}
+
 int EntryPointHandler::handle(int argCount, char **const ppArgs) {
-  if (argCount == 2) {
-    const std::string flag = std::string(ppArgs[1]);
-    if (flag == "--help") {
+  std::string flag = "--compile";
+  std::string path;
+  unsigned int level = 0;
+  unsigned int size = 0;
+  bool leveled = false;
+  // cheap pipeline of --optimize-compile-time
+  bool fast = false;
+  // other output than LLVM IR, --emit-obj, --emit-asm or --emit-bc
+  std::string emit;
+  // path given with -o
+  std::string output;
+  // --profile-generate and the profile of --profile-use
+  bool generate = false;
+  std::string use;
+  // number of shards of --jobs
+  unsigned int jobs = 1;
+  for (int i = 1; i < argCount; i++) {
+    const std::string arg = std::string(ppArgs[i]);
+    if (arg == "--help") {
       HELP;
       return EXIT_SUCCESS;
     }
-    const auto &path = flag;
-    std::ifstream file = std::ifstream(path);
-    std::string buffer((std::istreambuf_iterator<char>(file)),
-                       std::istreambuf_iterator<char>());
+    if (parseLevel(arg, level, size))
+      leveled = true;
+    else if (arg == "--emit-obj" || arg == "--emit-asm" || arg == "--emit-bc")
+      emit = arg;
+    else if (arg == "-o" && i + 1 < argCount)
+      output = ppArgs[++i];
+    else if (arg == "--profile-generate")
+      generate = true;
+    else if (arg.compare(0, 14, "--profile-use=") == 0)
+      use = arg.substr(14);
+    else if (arg.compare(0, 7, "--jobs=") == 0 &&
+             parseCount(arg.substr(7), jobs))
+      continue;
+    else if (isMode(arg))
+      flag = arg;
+    else if (path.empty() && arg[0] != '-')
+      path = arg;
+    else {
+      std::cerr << "unknown argument " << arg << ", see c4 --help"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (path.empty()) {
+    HELP;
+    return EXIT_SUCCESS;
+  }
+  if (jobs > 1 && ((emit != "--emit-obj" && emit != "--emit-asm") ||
+                   flag == "--run" || generate)) {
+    std::cerr << "--jobs needs --emit-obj or --emit-asm and can't be used "
+                 "with --run or --profile-generate"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!leveled) {
+    if (flag == "--optimize")
+      level = 2;
+    else if (flag == "--optimize-run-time")
+      level = 3;
+    else if (flag == "--optimize-compile-time")
+      fast = true;
+  }
+  std::ifstream file = std::ifstream(path);
+  std::string buffer((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+  if (flag == "--tokenize") {
+    auto lexer = FastLexer(buffer, path);
+    lexer.tokenize();
+    if (lexer.fail()) {
+      std::cerr << lexer.getError() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  } else if (flag == "--parse") {
+    PARSE;
+    SEMAN;
+    return EXIT_SUCCESS;
+  } else if (flag == "--print-ast") {
+    PARSE;
+    SEMAN;
+    PrettyPrinterVisitor pp;
+    std::cout << root->accept(&pp);
+    return EXIT_SUCCESS;
+  } else if (flag == "--graphviz") {
     PARSE;
     SEMAN;
+    GraphvizVisitor gv;
+    std::cout << root->accept(&gv) << std::endl;
+    return EXIT_SUCCESS;
+  } else if (flag == "--compile" || flag == "--optimize" ||
+             flag == "--optimize-run-time" ||
+             flag == "--optimize-compile-time" || flag == "--run") {
+    PARSE;
+    SEMAN;
+    FOLD;
+    if (jobs > 1)
+      return emitShards(root.get(), path, output, use, jobs, level, size, fast,
+                        emit == "--emit-asm"
+                            ? llvm::TargetMachine::CGFT_AssemblyFile
+                            : llvm::TargetMachine::CGFT_ObjectFile)
+                 ? EXIT_SUCCESS
+                 : EXIT_FAILURE;
     COMPILE;
     return EXIT_SUCCESS;
   }
-  if (argCount == 3) {
-    const std::string flag = std::string(ppArgs[1]);
-    std::string path = ppArgs[2];
-    std::ifstream file = std::ifstream(path);
-    std::string buffer((std::istreambuf_iterator<char>(file)),
-                       std::istreambuf_iterator<char>());
-    if (flag == "--tokenize") {
-      auto lexer = FastLexer(buffer, path);
-      lexer.tokenize();
-      if (lexer.fail()) {
-        std::cerr << lexer.getError() << std::endl;
-        return EXIT_FAILURE;
-      }
-      return EXIT_SUCCESS;
-    } else if (flag == "--parse") {
-      PARSE;
-      SEMAN;
-      return EXIT_SUCCESS;
-    } else if (flag == "--print-ast") {
-      PARSE;
-      SEMAN;
-      PrettyPrinterVisitor pp;
-      std::cout << root->accept(&pp);
-      return EXIT_SUCCESS;
-    } else if (flag == "--graphviz") {
-      PARSE;
-      SEMAN;
-      GraphvizVisitor gv;
-      std::cout << root->accept(&gv) << std::endl;
-      return EXIT_SUCCESS;
-    } else if (flag == "--compile") {
-      PARSE;
-      SEMAN;
-      COMPILE;
-      return EXIT_SUCCESS;
-    }
-  }
   HELP;
-  return EXIT_SUCCESS;
+  return EXIT_FAILURE;
 }
 } // namespace ccc
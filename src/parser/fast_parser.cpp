@@ -102,7 +102,7 @@ unique_ptr<ExternalDeclaration> FastParser::parseFuncDefOrDeclaration() {
 
   if (peek().is(TokenType::SEMICOLON)) {
     consume(TokenType::SEMICOLON);
-    if (type_node.second || type_node.first->getStructType()) {
+    if (type_node.second || isa<StructType>(type_node.first)) {
       return make_unique<StructDeclaration>(src_mark, move(type_node.first),
                                             move(identifier_node));
     }
@@ -298,14 +298,14 @@ unique_ptr<Declarator> FastParser::parseDirectDeclarator(bool, int ptrCount) {
   }
 
   if (ptrCount != 0) {
-    auto tmp = identifier->getFunctionDeclarator();
+    auto tmp = dyn_cast<FunctionDeclarator>(identifier);
     if (tmp) {
       auto return_ptr = make_unique<AbstractDeclarator>(
           global_mark, AbstractDeclType::Data,
-          tmp->return_ptr->getAbstractDeclarator()->pointerCount + ptrCount);
+          cast<AbstractDeclarator>(tmp->return_ptr)->pointerCount + ptrCount);
       return make_unique<FunctionDeclarator>(
-          tmp->getTokenRef(), move(tmp->identifier), move(tmp->param_list),
-          move(return_ptr));
+          Token(TokenType::GHOST, tmp->getLocation()), move(tmp->identifier),
+          move(tmp->param_list), move(return_ptr));
     } else
       identifier = make_unique<PointerDeclarator>(
           global_mark, std::move(identifier), ptrCount);
@@ -19,8 +19,9 @@ public:
   }
 
 private:
-  unsigned long line;
-  unsigned long column;
+  // 32 bit are enough for any source file and keep AST nodes small
+  unsigned int line;
+  unsigned int column;
 };
 
 } // namespace ccc
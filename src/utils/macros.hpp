@@ -22,10 +22,6 @@
       ". Compiling Stopped!"
 #define UNUSED(var) (void)var
 
-template <class DstType, class SrcType> bool instanceof (const SrcType *src) {
-  return dynamic_cast<const DstType *>(src) != nullptr;
-}
-
 #ifndef DEBUG
 #define DEBUG false
 #endif
@@ -1,5 +1,6 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
+#include "assert.hpp"
 #include <array>
 #include <cstddef>
 #include <cstdio>
@@ -56,6 +57,65 @@ struct EnumClassHash {
   }
 };
 
+/**
+ * LLVM style type test, asks the static classof of the target class which only
+ * compares the kind tag of the object
+ *
+ * @tparam To target class
+ * @param src object, may be null
+ * @return bool
+ */
+template <class To, class From> bool isa(const From *src) {
+  return src && To::classof(src);
+}
+
+template <class To, class From> bool isa(const std::unique_ptr<From> &src) {
+  return isa<To>(src.get());
+}
+
+template <class To, class From> bool isa(const std::shared_ptr<From> &src) {
+  return isa<To>(src.get());
+}
+
+/**
+ * checked downcast, the object has to be of the target class
+ *
+ * @tparam To target class
+ * @param src object
+ * @return object as target class
+ */
+template <class To, class From> To *cast(From *src) {
+  my_assert(isa<To>(src)) << "cast to incompatible class";
+  return static_cast<To *>(src);
+}
+
+template <class To, class From> To *cast(const std::unique_ptr<From> &src) {
+  return cast<To>(src.get());
+}
+
+template <class To, class From> To *cast(const std::shared_ptr<From> &src) {
+  return cast<To>(src.get());
+}
+
+/**
+ * downcast replacing dynamic_cast
+ *
+ * @tparam To target class
+ * @param src object, may be null
+ * @return object as target class or nullptr if it is of a different class
+ */
+template <class To, class From> To *dyn_cast(From *src) {
+  return isa<To>(src) ? static_cast<To *>(src) : nullptr;
+}
+
+template <class To, class From> To *dyn_cast(const std::unique_ptr<From> &src) {
+  return dyn_cast<To>(src.get());
+}
+
+template <class To, class From> To *dyn_cast(const std::shared_ptr<From> &src) {
+  return dyn_cast<To>(src.get());
+}
+
 class Utils {
 public:
   static std::vector<std::string> split_lines(const std::string &str) {
@@ -0,0 +1,108 @@
+#include "../catch.hpp"
+#include "ast/ast_node.hpp"
+
+namespace ccc {
+TEST_CASE("isa on node hierarchy") {
+  std::unique_ptr<Expression> e = make_unique<Unary>(
+      Token(), UnaryOpValue::MINUS, make_unique<Number>(Token(), 1));
+  REQUIRE(isa<Unary>(e));
+  REQUIRE(isa<Expression>(e));
+  REQUIRE(isa<ASTNode>(e.get()));
+  REQUIRE_FALSE(isa<Number>(e));
+  REQUIRE_FALSE(isa<Statement>(e));
+  REQUIRE_FALSE(isa<Declarator>(e));
+  auto s = make_unique<Break>(Token());
+  REQUIRE(isa<Statement>(s));
+  REQUIRE_FALSE(isa<Expression>(s));
+  REQUIRE_FALSE(isa<Number>(static_cast<Expression *>(nullptr)));
+}
+
+TEST_CASE("dyn_cast on node hierarchy") {
+  std::unique_ptr<Expression> e = make_unique<Number>(Token(), 42);
+  REQUIRE(dyn_cast<Number>(e) == e.get());
+  REQUIRE(dyn_cast<String>(e) == nullptr);
+  REQUIRE(dyn_cast<Unary>(static_cast<Expression *>(nullptr)) == nullptr);
+  REQUIRE(cast<Number>(e) == e.get());
+}
+
+TEST_CASE("isa on raw types") {
+  TypeContext types;
+  auto i = types.getScalar(RawTypeValue::INT);
+  auto n = types.getScalar(RawTypeValue::NIL);
+  auto p = types.getPointer(i);
+  auto f = types.getFunction(i, {p});
+  RawType *s = types.createStruct("struct S");
+  REQUIRE(isa<RawScalarType>(i));
+  REQUIRE(isa<RawScalarType>(n));
+  REQUIRE_FALSE(isa<RawScalarType>(p));
+  REQUIRE(isa<RawPointerType>(p));
+  REQUIRE(dyn_cast<RawFunctionType>(f) == f);
+  REQUIRE(dyn_cast<RawFunctionType>(s) == nullptr);
+  REQUIRE(cast<RawStructType>(s)->getName() == "struct S");
+}
+
+TEST_CASE("type context interns types") {
+  TypeContext types;
+  auto i = types.getScalar(RawTypeValue::INT);
+  auto c = types.getScalar(RawTypeValue::CHAR);
+  REQUIRE(i == types.getScalar(RawTypeValue::INT));
+  REQUIRE(types.getPointer(types.getPointer(c)) ==
+          types.getPointer(types.getPointer(c)));
+  REQUIRE(types.getPointer(i) != types.getPointer(c));
+  auto f = types.getFunction(i, {types.getPointer(c), i});
+  REQUIRE(f == types.getFunction(i, {types.getPointer(c), i}));
+  REQUIRE(f != types.getFunction(i, {i, types.getPointer(c)}));
+  REQUIRE(f != types.getFunction(c, {types.getPointer(c), i}));
+  REQUIRE(types.createStruct("struct S") != types.createStruct("struct S"));
+}
+
+TEST_CASE("exact type comparison") {
+  TypeContext types;
+  auto n = types.getScalar(RawTypeValue::NIL);
+  auto i = types.getScalar(RawTypeValue::INT);
+  auto c = types.getScalar(RawTypeValue::CHAR);
+  auto v = types.getScalar(RawTypeValue::VOID);
+  auto p = types.getPointer(c);
+  REQUIRE(p->compare_exact(types.getPointer(c)));
+  REQUIRE_FALSE(p->compare_exact(types.getPointer(i)));
+  REQUIRE(p->compare_exact(n));
+  REQUIRE(i->compare_exact(n));
+  REQUIRE_FALSE(c->compare_exact(n));
+  REQUIRE(n->compare_exact(c));
+  REQUIRE_FALSE(v->compare_exact(n));
+  REQUIRE_FALSE(i->compare_exact(c));
+  REQUIRE(i->compare_exact(types.getPtrDiff()));
+  REQUIRE(types.getFunction(i, {p})->compare_exact(n));
+}
+
+TEST_CASE("struct layout") {
+  TypeContext types;
+  auto s = types.createStruct("struct S");
+  REQUIRE(s->size() == 0);
+  s->complete({1, 4, 1, 8});
+  REQUIRE(s->size() == 24);
+  REQUIRE(s->getLayout().align == 8);
+  REQUIRE(s->getLayout().offsets == std::vector<int>({0, 4, 8, 16}));
+  REQUIRE(types.getPointer(s)->ptr_size() == 24);
+}
+
+TEST_CASE("compatibility cache") {
+  TypeContext types;
+  CompatibilityCache cache;
+  auto i = types.getScalar(RawTypeValue::INT);
+  auto c = types.getScalar(RawTypeValue::CHAR);
+  auto f = types.getFunction(i, {types.getPointer(c)});
+  auto g = types.getFunction(i, {});
+  auto pv = types.getPointer(types.getScalar(RawTypeValue::VOID));
+  auto s = types.createStruct("struct S");
+  for (int round = 0; round < 2; round++) {
+    REQUIRE(cache.compatible(f, f));
+    REQUIRE_FALSE(cache.compatible(f, g));
+    REQUIRE(cache.compatible(types.getPointer(c), pv));
+    REQUIRE_FALSE(cache.compatible(types.getPointer(c), s));
+    REQUIRE(cache.compatible(s, s));
+    REQUIRE(cache.compatible(i, c));
+    REQUIRE_FALSE(cache.compatible(i, nullptr));
+  }
+}
+} // namespace ccc
@@ -0,0 +1,112 @@
+#include "../catch.hpp"
+#include "ast/traversal.hpp"
+#include "ast/visitor/constant_folding.hpp"
+#include "ast/visitor/pretty_printer.hpp"
+#include "ast/visitor/semantic_analysis.hpp"
+#include "parser/fast_parser.hpp"
+
+#define REQUIRE_FOLD(input, output)                                            \
+  auto fp = FastParser(input);                                                 \
+  auto root = fp.parse();                                                      \
+  REQUIRE_SUCCESS(fp);                                                         \
+  SemanticVisitor sv;                                                          \
+  root->accept(&sv);                                                           \
+  REQUIRE_SUCCESS(sv);                                                         \
+  auto before = countNodes(root.get());                                        \
+  ConstantFoldingVisitor fv;                                                   \
+  root->accept(&fv);                                                           \
+  PrettyPrinterVisitor pp;                                                     \
+  REQUIRE_EMPTY(Utils::compare(root->accept(&pp), output));
+
+namespace ccc {
+TEST_CASE("fold constant expressions") {
+  std::string input = "int main() {\n"
+                      "  int a;\n"
+                      "  a = 2 * 3 + 4 - sizeof(int) + 'a';\n"
+                      "  a = -(1 - 3) + !5 + !0 + (1 < 2) + (3 != 3);\n"
+                      "  a = 2147483647 + 1;\n"
+                      "  a = sizeof(\"a\\n\") + sizeof(sizeof(a));\n"
+                      "  return (0 && a) + (1 || a) + (1 ? 10 : 20);\n"
+                      "}\n";
+  REQUIRE_FOLD(input, "int (main())\n"
+                      "{\n"
+                      "\tint a;\n"
+                      "\t(a = 103);\n"
+                      "\t(a = 4);\n"
+                      "\t(a = (-2147483648));\n"
+                      "\t(a = 11);\n"
+                      "\treturn 11;\n"
+                      "}\n");
+  REQUIRE(countNodes(root.get()) < before);
+}
+
+TEST_CASE("simplify identities") {
+  std::string input = "int main() {\n"
+                      "  int a;\n"
+                      "  char c;\n"
+                      "  a = a * 1 + 0;\n"
+                      "  a = 0 + (1 * a - 0);\n"
+                      "  a = !!(a < 2) + !!a;\n"
+                      "  a = (1 && a == 2) + (0 || !a);\n"
+                      "  a = c + 0;\n"
+                      "  if (!!a)\n"
+                      "    return 1;\n"
+                      "  return 0;\n"
+                      "}\n";
+  // c + 0 is an int, c only a char
+  REQUIRE_FOLD(input, "int (main())\n"
+                      "{\n"
+                      "\tint a;\n"
+                      "\tchar c;\n"
+                      "\t(a = a);\n"
+                      "\t(a = a);\n"
+                      "\t(a = ((a < 2) + (!(!a))));\n"
+                      "\t(a = ((a == 2) + (!a)));\n"
+                      "\t(a = (c + 0));\n"
+                      "\tif (a)\n"
+                      "\t\treturn 1;\n"
+                      "\treturn 0;\n"
+                      "}\n");
+}
+
+TEST_CASE("prune constant conditions") {
+  std::string input = "int main() {\n"
+                      "  int a;\n"
+                      "  a = 0;\n"
+                      "  if (1 < 2) {\n"
+                      "    a = 1;\n"
+                      "  } else {\n"
+                      "    a = 2;\n"
+                      "  }\n"
+                      "  if (0)\n"
+                      "    a = 3;\n"
+                      "  while (1 - 1)\n"
+                      "    a = 4;\n"
+                      "  while (0) {\n"
+                      "  l:\n"
+                      "    a = 5;\n"
+                      "  }\n"
+                      "  goto l;\n"
+                      "}\n";
+  // the label can still be reached
+  std::string output = "int (main())\n"
+                       "{\n"
+                       "\tint a;\n"
+                       "\t(a = 0);\n"
+                       "\t{\n"
+                       "\t\t(a = 1);\n"
+                       "\t}\n"
+                       "\twhile (0) {\n"
+                       "l:\n"
+                       "\t\t(a = 5);\n"
+                       "\t}\n"
+                       "\tgoto l;\n"
+                       "}\n";
+  REQUIRE_FOLD(input, output);
+  // the printed AST is valid source again
+  auto reparsed = FastParser(output);
+  auto again = reparsed.parse();
+  REQUIRE_SUCCESS(reparsed);
+  REQUIRE_EMPTY(Utils::compare(again->accept(&pp), output));
+}
+} // namespace ccc
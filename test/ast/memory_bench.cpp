@@ -0,0 +1,67 @@
+#include "../catch.hpp"
+#include "program_generator.hpp"
+#include "ast/traversal.hpp"
+#include "parser/fast_parser.hpp"
+
+#define SIZE_OF(X)                                                             \
+  std::size_t visit##X(X *) { return sizeof(X); }
+
+namespace ccc {
+// size of the visited node object, without the nodes it owns
+class SizeVisitor : public StaticVisitor<SizeVisitor, std::size_t> {
+public:
+  SIZE_OF(TranslationUnit)
+  SIZE_OF(FunctionDefinition)
+  SIZE_OF(FunctionDeclaration)
+  SIZE_OF(DataDeclaration)
+  SIZE_OF(StructDeclaration)
+  SIZE_OF(ParamDeclaration)
+  SIZE_OF(ScalarType)
+  SIZE_OF(StructType)
+  SIZE_OF(AbstractType)
+  SIZE_OF(DirectDeclarator)
+  SIZE_OF(AbstractDeclarator)
+  SIZE_OF(PointerDeclarator)
+  SIZE_OF(FunctionDeclarator)
+  SIZE_OF(CompoundStmt)
+  SIZE_OF(IfElse)
+  SIZE_OF(Label)
+  SIZE_OF(While)
+  SIZE_OF(Goto)
+  SIZE_OF(ExpressionStmt)
+  SIZE_OF(Break)
+  SIZE_OF(Return)
+  SIZE_OF(Continue)
+  SIZE_OF(VariableName)
+  SIZE_OF(Number)
+  SIZE_OF(Character)
+  SIZE_OF(String)
+  SIZE_OF(MemberAccessOp)
+  SIZE_OF(ArraySubscriptOp)
+  SIZE_OF(FunctionCall)
+  SIZE_OF(Unary)
+  SIZE_OF(SizeOf)
+  SIZE_OF(Binary)
+  SIZE_OF(Ternary)
+  SIZE_OF(Assignment)
+};
+
+TEST_CASE("ast bytes per node") {
+  auto input = program(20000);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  BENCHMARK("size") {
+    SizeVisitor sv;
+    std::size_t nodes = 0, bytes = 0;
+    preOrder(root.get(), [&nodes, &bytes, &sv](ASTNode *n) {
+      nodes++;
+      bytes += n->accept(&sv);
+    });
+    auto tables = cast<TranslationUnit>(root)->getSemanticTable().bytes();
+    std::cout << nodes << " nodes, " << bytes << " bytes in nodes, " << tables
+              << " bytes in side tables, " << (bytes + tables) / nodes
+              << " bytes/node" << std::endl;
+  }
+}
+} // namespace ccc
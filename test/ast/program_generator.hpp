@@ -0,0 +1,64 @@
+#ifndef C4_PROGRAM_GENERATOR_HPP
+#define C4_PROGRAM_GENERATOR_HPP
+#include <string>
+
+namespace ccc {
+/**
+ * generate a valid program with the given number of functions, used as input
+ * for benchmarks - the files in examples are mostly lexer stress tests
+ *
+ * @param functions number of functions
+ * @return source code
+ */
+inline std::string program(unsigned int functions) {
+  std::string input;
+  for (unsigned int i = 0; i < functions; i++) {
+    auto name = "f" + std::to_string(i);
+    input += "int " + name + "(int a, int b) {\n"
+             "  int c;\n"
+             "  c = a * 2 + b;\n"
+             "  while (0 < c) {\n"
+             "    if (c < b && !(a == 3))\n"
+             "      c = c - 1;\n"
+             "    else\n"
+             "      c = c - a * (b + 1);\n"
+             "  }\n"
+             "  return c + sizeof(int);\n"
+             "}\n";
+  }
+  return input;
+}
+
+/**
+ * generate a program whose functions mostly declare, pass and assign pointers
+ * of several levels, so code generation is dominated by types
+ *
+ * @param functions number of functions
+ * @return source code
+ */
+inline std::string declarations(unsigned int functions) {
+  std::string input;
+  for (unsigned int i = 0; i < functions; i++) {
+    auto name = "f" + std::to_string(i);
+    auto callee = i > 0 ? "f" + std::to_string(i - 1) : name;
+    input += "char **g" + std::to_string(i) + ";\n"
+             "int *" + name + "(int *a, char **b, int **c, char ***d) {\n"
+             "  int *w;\n"
+             "  char **x;\n"
+             "  int **y;\n"
+             "  char ***z;\n"
+             "  w = a;\n"
+             "  x = b;\n"
+             "  y = c;\n"
+             "  z = d;\n"
+             "  g" + std::to_string(i) + " = x;\n"
+             "  if (a == 0)\n"
+             "    return " + callee + "(w, x, y, z);\n"
+             "  return *y;\n"
+             "}\n";
+  }
+  return input;
+}
+} // namespace ccc
+
+#endif // C4_PROGRAM_GENERATOR_HPP
@@ -0,0 +1,106 @@
+#include "../catch.hpp"
+#include "program_generator.hpp"
+#include "ast/traversal.hpp"
+#include "ast/visitor/pretty_printer.hpp"
+#include "parser/fast_parser.hpp"
+#include <chrono>
+
+#define COUNT(X)                                                               \
+  std::string visit##X(X *v) override { return visitChildren(v); }
+
+namespace ccc {
+// counts nodes by recursing through accept(), like the classic visitors
+class CountingVisitor : public Visitor<std::string> {
+public:
+  std::size_t count = 0;
+
+  std::string visitChildren(ASTNode *node) {
+    ASTNodeRefListType children;
+    node->children(children);
+    count++;
+    for (const auto &c : children)
+      c->accept(this);
+    return "";
+  }
+
+  COUNT(TranslationUnit)
+  COUNT(FunctionDefinition)
+  COUNT(FunctionDeclaration)
+  COUNT(DataDeclaration)
+  COUNT(StructDeclaration)
+  COUNT(ParamDeclaration)
+  COUNT(ScalarType)
+  COUNT(StructType)
+  COUNT(AbstractType)
+  COUNT(DirectDeclarator)
+  COUNT(AbstractDeclarator)
+  COUNT(PointerDeclarator)
+  COUNT(FunctionDeclarator)
+  COUNT(CompoundStmt)
+  COUNT(IfElse)
+  COUNT(Label)
+  COUNT(While)
+  COUNT(Goto)
+  COUNT(ExpressionStmt)
+  COUNT(Break)
+  COUNT(Return)
+  COUNT(Continue)
+  COUNT(VariableName)
+  COUNT(Number)
+  COUNT(Character)
+  COUNT(String)
+  COUNT(MemberAccessOp)
+  COUNT(ArraySubscriptOp)
+  COUNT(FunctionCall)
+  COUNT(Unary)
+  COUNT(SizeOf)
+  COUNT(Binary)
+  COUNT(Ternary)
+  COUNT(Assignment)
+};
+
+template <class F> void report(const std::string &name, F f) {
+  const int rounds = 10;
+  std::size_t visits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++)
+    visits += f();
+  std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << visits / rounds << " nodes, "
+            << static_cast<unsigned long>(visits / time.count())
+            << " visits/s" << std::endl;
+}
+
+TEST_CASE("traversal visits per second") {
+  auto input = program(20000);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto tree = root.get();
+  auto nodes = countNodes(tree);
+  BENCHMARK("recursive accept") {
+    report("recursive accept", [tree]() {
+      CountingVisitor cv;
+      tree->accept(&cv);
+      return cv.count;
+    });
+  }
+  BENCHMARK("pretty printer") {
+    report("pretty printer", [tree, nodes]() {
+      PrettyPrinterVisitor pp;
+      tree->accept(&pp);
+      return nodes;
+    });
+  }
+  BENCHMARK("pre-order") {
+    report("pre-order", [tree]() { return countNodes(tree); });
+  }
+  BENCHMARK("post-order") {
+    report("post-order", [tree]() {
+      std::size_t count = 0;
+      postOrder(tree, [&count](ASTNode *) { count++; });
+      return count;
+    });
+  }
+}
+} // namespace ccc
@@ -0,0 +1,128 @@
+#include "../catch.hpp"
+#include "ast/traversal.hpp"
+#include "ast/visitor/pretty_printer.hpp"
+#include "parser/fast_parser.hpp"
+
+namespace ccc {
+std::vector<std::string> printAll(const std::vector<ASTNode *> &nodes) {
+  std::vector<std::string> res;
+  PrettyPrinterVisitor pp;
+  for (const auto &n : nodes)
+    res.push_back(n->accept(&pp));
+  return res;
+}
+
+std::string sumOf(unsigned int terms) {
+  std::string input = "int main() {\n  return 1";
+  for (unsigned int i = 1; i < terms; i++)
+    input += " + 1";
+  return input + ";\n}\n";
+}
+
+TEST_CASE("traversal pre-order") {
+  std::string input = "(1 + 2) * (3 + 4)";
+  auto fp = FastParser(input);
+  auto root = fp.parse(PARSE_TYPE::EXPRESSION);
+  REQUIRE_SUCCESS(fp);
+  std::vector<ASTNode *> nodes;
+  preOrder(root.get(), [&nodes](ASTNode *n) { nodes.push_back(n); });
+  REQUIRE(printAll(nodes) ==
+          std::vector<std::string>({"((1 + 2) * (3 + 4))", "(1 + 2)", "1",
+                                    "2", "(3 + 4)", "3", "4"}));
+}
+
+TEST_CASE("traversal post-order") {
+  std::string input = "(1 + 2) * (3 + 4)";
+  auto fp = FastParser(input);
+  auto root = fp.parse(PARSE_TYPE::EXPRESSION);
+  REQUIRE_SUCCESS(fp);
+  std::vector<ASTNode *> nodes;
+  postOrder(root.get(), [&nodes](ASTNode *n) { nodes.push_back(n); });
+  REQUIRE(printAll(nodes) ==
+          std::vector<std::string>({"1", "2", "(1 + 2)", "3", "4", "(3 + 4)",
+                                    "((1 + 2) * (3 + 4))"}));
+}
+
+TEST_CASE("traversal skip children") {
+  std::string input = "(1 + 2) * (3 + 4)";
+  auto fp = FastParser(input);
+  auto root = fp.parse(PARSE_TYPE::EXPRESSION);
+  REQUIRE_SUCCESS(fp);
+  std::vector<ASTNode *> nodes;
+  PreOrderIterator it(root.get());
+  while (auto n = it.next()) {
+    nodes.push_back(n);
+    if (n != root.get())
+      it.skipChildren();
+  }
+  REQUIRE(printAll(nodes) == std::vector<std::string>(
+                                 {"((1 + 2) * (3 + 4))", "(1 + 2)", "(3 + 4)"}));
+}
+
+TEST_CASE("traversal post-order without expanding") {
+  std::string input = "(1 + 2) * -(3 + 4)";
+  auto fp = FastParser(input);
+  auto root = fp.parse(PARSE_TYPE::EXPRESSION);
+  REQUIRE_SUCCESS(fp);
+  std::vector<ASTNode *> nodes;
+  PostOrderIterator it(root.get(), [](ASTNode *n) { return isa<Binary>(n); });
+  while (auto n = it.next())
+    nodes.push_back(n);
+  REQUIRE(printAll(nodes) ==
+          std::vector<std::string>(
+              {"1", "2", "(1 + 2)", "(-(3 + 4))", "((1 + 2) * (-(3 + 4)))"}));
+}
+
+TEST_CASE("traversal skips empty slots") {
+  std::string input = "int main() {\n"
+                      "  if (1)\n"
+                      "    return;\n"
+                      "  ;\n"
+                      "}\n";
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  // unit, definition, int, declarator, main, name, return pointer, body, if,
+  // condition, return, empty statement
+  REQUIRE(countNodes(root.get()) == 12);
+  std::size_t post = 0;
+  postOrder(root.get(), [&post](ASTNode *) { post++; });
+  REQUIRE(post == 12);
+}
+
+TEST_CASE("traversal deep left associative expression") {
+  const unsigned int terms = 200000;
+  auto input = sumOf(terms);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  // expression: terms numbers and terms - 1 additions on top of the 9 nodes
+  // of the surrounding function
+  REQUIRE(countNodes(root.get()) == 2 * terms - 1 + 9);
+  std::size_t post = 0;
+  ASTNode *last = nullptr;
+  postOrder(root.get(), [&post, &last](ASTNode *n) {
+    post++;
+    last = n;
+  });
+  REQUIRE(post == 2 * terms - 1 + 9);
+  REQUIRE(last == root.get());
+  // tear down without recursion
+  root.reset();
+}
+
+TEST_CASE("traversal deep unary chain") {
+  const unsigned int depth = 1000000;
+  std::unique_ptr<Expression> e = make_unique<Number>(Token(), 1);
+  for (unsigned int i = 0; i < depth; i++)
+    e = make_unique<Unary>(Token(), UnaryOpValue::MINUS, std::move(e));
+  REQUIRE(countNodes(e.get()) == depth + 1);
+  // the innermost number is visited first
+  PostOrderIterator it(e.get());
+  PrettyPrinterVisitor pp;
+  REQUIRE(it.next()->accept(&pp) == "1");
+  ASTNodeListType pending;
+  pending.push_back(std::move(e));
+  destroyTree(std::move(pending));
+}
+} // namespace ccc
@@ -0,0 +1,92 @@
+#include "../catch.hpp"
+#include "ast/traversal.hpp"
+#include "parser/fast_parser.hpp"
+
+#define NAME_OF(X)                                                             \
+  const char *visit##X(X *) { return #X; }
+
+namespace ccc {
+// name of the visited node class, resolved without virtual calls
+class KindNameVisitor : public StaticVisitor<KindNameVisitor, const char *> {
+public:
+  NAME_OF(TranslationUnit)
+  NAME_OF(FunctionDefinition)
+  NAME_OF(FunctionDeclaration)
+  NAME_OF(DataDeclaration)
+  NAME_OF(StructDeclaration)
+  NAME_OF(ParamDeclaration)
+  NAME_OF(ScalarType)
+  NAME_OF(StructType)
+  NAME_OF(AbstractType)
+  NAME_OF(DirectDeclarator)
+  NAME_OF(AbstractDeclarator)
+  NAME_OF(PointerDeclarator)
+  NAME_OF(FunctionDeclarator)
+  NAME_OF(CompoundStmt)
+  NAME_OF(IfElse)
+  NAME_OF(Label)
+  NAME_OF(While)
+  NAME_OF(Goto)
+  NAME_OF(ExpressionStmt)
+  NAME_OF(Break)
+  NAME_OF(Return)
+  NAME_OF(Continue)
+  NAME_OF(VariableName)
+  NAME_OF(Number)
+  NAME_OF(Character)
+  NAME_OF(String)
+  NAME_OF(MemberAccessOp)
+  NAME_OF(ArraySubscriptOp)
+  NAME_OF(FunctionCall)
+  NAME_OF(Unary)
+  NAME_OF(SizeOf)
+  NAME_OF(Binary)
+  NAME_OF(Ternary)
+  NAME_OF(Assignment)
+};
+
+TEST_CASE("static visitor dispatches on node kind") {
+  std::string input = "(1 + 2) * x";
+  auto fp = FastParser(input);
+  auto root = fp.parse(PARSE_TYPE::EXPRESSION);
+  REQUIRE_SUCCESS(fp);
+  KindNameVisitor kv;
+  std::vector<std::string> names;
+  preOrder(root.get(),
+           [&names, &kv](ASTNode *n) { names.emplace_back(n->accept(&kv)); });
+  REQUIRE(names == std::vector<std::string>({"Binary", "Binary", "Number",
+                                             "Number", "VariableName"}));
+}
+
+TEST_CASE("static visitor covers all statements") {
+  std::string input = "struct S { int x; };\n"
+                      "int f(char *s);\n"
+                      "int main() {\n"
+                      "  struct S a;\n"
+                      "  while (1) {\n"
+                      "    if (a.x < 'c')\n"
+                      "      break;\n"
+                      "    else\n"
+                      "      continue;\n"
+                      "  }\n"
+                      "l:\n"
+                      "  goto l;\n"
+                      "  return f(\"s\") ? sizeof(int) : -a.x;\n"
+                      "}\n";
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  KindNameVisitor kv;
+  std::unordered_set<std::string> names;
+  preOrder(root.get(),
+           [&names, &kv](ASTNode *n) { names.emplace(n->accept(&kv)); });
+  for (const auto &name :
+       {"TranslationUnit", "StructDeclaration", "StructType", "DataDeclaration",
+        "FunctionDeclaration", "FunctionDefinition", "FunctionDeclarator",
+        "ParamDeclaration", "PointerDeclarator", "CompoundStmt", "While",
+        "IfElse", "Break", "Continue", "Label", "Goto", "Return", "Ternary",
+        "FunctionCall", "String", "SizeOf", "Unary", "MemberAccessOp",
+        "Character", "Binary", "ScalarType", "DirectDeclarator"})
+    REQUIRE(names.count(name) == 1);
+}
+} // namespace ccc
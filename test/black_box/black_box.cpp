@@ -48,6 +48,22 @@ TEST_CASE("help") {
   delete[] ppArgs;
 }
 
+TEST_CASE("unknown option") {
+  for (std::string flag : {"--optimise", "--emit-ob", "-O4"}) {
+    std::string input = "test.c";
+    std::cout << "./c4 " << flag << " " << input << std::endl;
+    PIPE_CERR;
+    char **ppArgs = new char *[3];
+    ppArgs[1] = &flag[0];
+    ppArgs[2] = &input[0];
+    int ret = EntryPointHandler().handle(3, ppArgs);
+    PIPE_CERR_RESET;
+    REQUIRE(ret == EXIT_FAILURE);
+    REQUIRE(error_content == "unknown argument " + flag + ", see c4 --help");
+    delete[] ppArgs;
+  }
+}
+
 TEST_CASE("lexer_failure_files") {
   std::string dir = ROOT_DIR + "lexer_failure_files/";
   for (const auto &file : Utils::dir(&dir[0])) {
@@ -146,6 +162,26 @@ TEST_CASE("pretty_printer_files") {
   }
 }
 
+TEST_CASE("deep expression") {
+  // a left associative chain of 200000 additions, deeper than the stack
+  // allows for one call per node
+  std::string flag = "--parse";
+  std::string input = "deep.c";
+  std::ofstream os(input);
+  os << "int main() {\n  return 1";
+  for (int i = 1; i < 200000; i++)
+    os << " + 1";
+  os << ";\n}\n";
+  os.close();
+  std::cout << "./c4 " << flag << " " << input << std::endl;
+  char **ppArgs = new char *[3];
+  ppArgs[1] = &flag[0];
+  ppArgs[2] = &input[0];
+  int ret = EntryPointHandler().handle(3, ppArgs);
+  REQUIRE(ret == EXIT_SUCCESS);
+  delete[] ppArgs;
+}
+
 TEST_CASE("compiler_success_files") {
   std::string dir = ROOT_DIR + "compiler_success_files/local/";
   for (const auto &file : Utils::dir(&dir[0])) {
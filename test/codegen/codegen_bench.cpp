@@ -0,0 +1,206 @@
+#include "../catch.hpp"
+#include "../ast/program_generator.hpp"
+#include "ast/visitor/codegen.hpp"
+#include "ast/visitor/semantic_analysis.hpp"
+#include "parser/fast_parser.hpp"
+#include <chrono>
+#include <fstream>
+
+namespace ccc {
+TEST_CASE("codegen of a large program") {
+  auto input = program(20000);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  BENCHMARK("program") {
+    const int rounds = 5;
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < rounds; i++) {
+      auto start = std::chrono::steady_clock::now();
+      CodegenVisitor cv("bench.c");
+      root->accept(&cv);
+      best = std::min<std::chrono::duration<double>>(
+          best, std::chrono::steady_clock::now() - start);
+    }
+    std::cout << "program: " << best.count() * 1000 << " ms" << std::endl;
+  }
+}
+
+TEST_CASE("codegen of declaration-heavy code") {
+  auto input = declarations(20000);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  BENCHMARK("declarations") {
+    const int rounds = 5;
+    auto best = std::chrono::duration<double>::max();
+    for (int i = 0; i < rounds; i++) {
+      auto start = std::chrono::steady_clock::now();
+      CodegenVisitor cv("bench.c");
+      root->accept(&cv);
+      best = std::min<std::chrono::duration<double>>(
+          best, std::chrono::steady_clock::now() - start);
+    }
+    std::cout << "declarations: " << best.count() * 1000 << " ms" << std::endl;
+  }
+}
+
+TEST_CASE("run time of optimized code") {
+  std::string input = "int step(int s, int i) {\n"
+                      "  if (s < 1000000)\n"
+                      "    return s + i * 3;\n"
+                      "  return s - 999983;\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  int k;\n"
+                      "  int s;\n"
+                      "  k = 0;\n"
+                      "  s = 0;\n"
+                      "  while (k < 50000000) {\n"
+                      "    s = step(s, k);\n"
+                      "    k = k + 1;\n"
+                      "  }\n"
+                      "  return s == 42;\n"
+                      "}\n";
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  double unoptimized = 0;
+  for (unsigned int level = 0; level <= 3; level++) {
+    BENCHMARK("-O" + std::to_string(level)) {
+      CodegenVisitor cv("bench.c");
+      root->accept(&cv);
+      cv.optimize(level);
+      cv.compile();
+      system("../../llvm/install/bin/clang -w -o bench bench.ll");
+      const int rounds = 3;
+      auto best = std::chrono::duration<double>::max();
+      for (int i = 0; i < rounds; i++) {
+        auto start = std::chrono::steady_clock::now();
+        system("./bench");
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+      }
+      if (level == 0)
+        unoptimized = best.count();
+      std::cout << "-O" << level << ": " << best.count() * 1000 << " ms, "
+                << unoptimized / best.count() << "x" << std::endl;
+    }
+  }
+}
+
+TEST_CASE("compile time of the optimization modes") {
+  auto input = program(20000);
+  const std::vector<std::string> modes = {"default", "compile-time", "-O1",
+                                          "-O2"};
+  double serial = 0;
+  for (const auto &mode : modes) {
+    BENCHMARK(mode) {
+      const int rounds = 3;
+      auto best = std::chrono::duration<double>::max();
+      for (int i = 0; i < rounds; i++) {
+        auto start = std::chrono::steady_clock::now();
+        auto fp = FastParser(input);
+        auto root = fp.parse();
+        SemanticVisitor sv;
+        root->accept(&sv);
+        CodegenVisitor cv("bench.c");
+        root->accept(&cv);
+        if (mode == "compile-time")
+          cv.optimizeCompileTime();
+        else if (mode != "default")
+          cv.optimize(static_cast<unsigned int>(mode[2] - '0'));
+        cv.compile(mode != "compile-time");
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+        REQUIRE_SUCCESS(sv);
+      }
+      if (mode == "default")
+        serial = best.count();
+      std::cout << mode << ": " << best.count() * 1000 << " ms, "
+                << serial / best.count() << "x" << std::endl;
+    }
+  }
+}
+
+TEST_CASE("textual IR and bitcode output") {
+  auto input = program(20000);
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("bench.c");
+  root->accept(&cv);
+  for (const std::string format : {".ll", ".bc"}) {
+    BENCHMARK(format) {
+      const int rounds = 5;
+      auto best = std::chrono::duration<double>::max();
+      for (int i = 0; i < rounds; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (format == ".ll")
+          cv.compile(false);
+        else
+          cv.emitBitcode();
+        best = std::min<std::chrono::duration<double>>(
+            best, std::chrono::steady_clock::now() - start);
+      }
+      std::ifstream file("bench" + format,
+                         std::ifstream::ate | std::ifstream::binary);
+      std::cout << format << ": " << best.count() * 1000 << " ms, "
+                << file.tellg() / 1024 << " KiB" << std::endl;
+    }
+  }
+}
+
+TEST_CASE("time to result of small programs") {
+  std::string input = "int fib(int n) {\n"
+                      "  if (n < 2)\n"
+                      "    return n;\n"
+                      "  return fib(n - 1) + fib(n - 2);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  return fib(20) - 6765;\n"
+                      "}\n";
+  const int programs = 20;
+  double files = 0;
+  for (const std::string mode : {"files", "jit"}) {
+    BENCHMARK(mode) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < programs; i++) {
+        auto fp = FastParser(input);
+        auto root = fp.parse();
+        SemanticVisitor sv;
+        root->accept(&sv);
+        CodegenVisitor cv("bench.c");
+        root->accept(&cv);
+        int ret;
+        if (mode == "files") {
+          cv.compile();
+          system("../../llvm/install/bin/clang -w -o bench bench.ll");
+          ret = WEXITSTATUS(system("./bench"));
+        } else
+          ret = cv.run();
+        REQUIRE(ret == 0);
+      }
+      std::chrono::duration<double> time =
+          std::chrono::steady_clock::now() - start;
+      if (mode == "files")
+        files = time.count();
+      std::cout << mode << ": " << time.count() * 1000 / programs
+                << " ms per program, " << files / time.count() << "x"
+                << std::endl;
+    }
+  }
+}
+} // namespace ccc
@@ -3,6 +3,7 @@
 #include "ast/visitor/codegen.hpp"
 #include "ast/visitor/semantic_analysis.hpp"
 #include "parser/fast_parser.hpp"
+#include <thread>
 
 #define PRINT_START(n)                                                         \
   std::cout                                                                    \
@@ -13,7 +14,8 @@
       << "\n============================================================="     \
          "==================\033[0m"                                           \
       << std::endl;
-#define REQUIRE_BUILD                                                          \
+#define REQUIRE_BUILD REQUIRE_BUILD_WITH(0)
+#define REQUIRE_BUILD_WITH(level)                                              \
   FastParser fp = FastParser(input);                                           \
   auto root = fp.parse();                                                      \
   REQUIRE_SUCCESS(fp);                                                         \
@@ -22,6 +24,8 @@
   REQUIRE_SUCCESS(sv);                                                         \
   CodegenVisitor cv("test.c");                                                 \
   root->accept(&cv);                                                           \
+  if (level > 0)                                                               \
+    REQUIRE(cv.optimize(level));                                               \
   cv.compile();                                                                \
   cv.dump();                                                                   \
   system("../../llvm/install/bin/clang -w -o test test.ll");
@@ -651,4 +655,583 @@ TEST_CASE("return in while") {
   REQUIRE_RUN("", 1);
   cv.dump();
 }
+
+TEST_CASE("shadowed variable") {
+  PRINT_START("shadowed variable");
+  std::string input = "int x;\n"
+                      "int main() {\n"
+                      "  int x;\n"
+                      "  x = 40;\n"
+                      "  {\n"
+                      "    int x;\n"
+                      "    x = 1;\n"
+                      "  }\n"
+                      "  return x + 2;\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 42);
+}
+
+TEST_CASE("optimized fib") {
+  PRINT_START("optimized fib");
+  std::string input = "int fib(int n) {\n"
+                      "  if (n < 2)\n"
+                      "    return n;\n"
+                      "  return fib(n - 1) + fib(n - 2);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  int i;\n"
+                      "  int sum;\n"
+                      "  i = 0;\n"
+                      "  sum = 0;\n"
+                      "  while (i < 10) {\n"
+                      "    sum = sum + fib(i);\n"
+                      "    i = i + 1;\n"
+                      "  }\n"
+                      "  return sum;\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD_WITH(3);
+  REQUIRE_RUN("", 88);
+}
+
+TEST_CASE("compile time pipeline") {
+  PRINT_START("compile time pipeline");
+  std::string input = "int main() {\n"
+                      "  int i;\n"
+                      "  int sum;\n"
+                      "  i = 0;\n"
+                      "  sum = 0;\n"
+                      "  while (i < 10) {\n"
+                      "    if (i != 5)\n"
+                      "      sum = sum + i;\n"
+                      "    i = i + 1;\n"
+                      "  }\n"
+                      "  return sum;\n"
+                      "}\n";
+  CLANG;
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("test.c");
+  root->accept(&cv);
+  cv.optimizeCompileTime();
+  cv.compile(false);
+  cv.dump();
+  system("../../llvm/install/bin/clang -w -o test test.ll");
+  REQUIRE_RUN("", 40);
+}
+
+TEST_CASE("native object") {
+  PRINT_START("native object");
+  std::string input = "int fac(int n) {\n"
+                      "  if (n < 2)\n"
+                      "    return 1;\n"
+                      "  return n * fac(n - 1);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  return fac(5) - 100;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("test.c");
+  REQUIRE(cv.setTarget(2));
+  root->accept(&cv);
+  cv.optimize(2);
+  REQUIRE(cv.emit(llvm::TargetMachine::CGFT_ObjectFile));
+  system("../../llvm/install/bin/clang -w -o test test.o");
+  REQUIRE_RUN("", 20);
+}
+
+TEST_CASE("functions split into shards") {
+  PRINT_START("functions split into shards");
+  std::string input = "int g;\n"
+                      "int add(int a, int b) {\n"
+                      "  return a + b;\n"
+                      "}\n"
+                      "int twice(int a) {\n"
+                      "  g = g + 1;\n"
+                      "  return add(a, a);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  char *s;\n"
+                      "  s = \"ab\";\n"
+                      "  return twice(20) + g + s[1] - 98;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  std::vector<std::unique_ptr<CodegenVisitor>> shards;
+  for (unsigned int i = 0; i < 3; i++) {
+    shards.push_back(make_unique<CodegenVisitor>("test.c"));
+    shards.back()->setShard(i, 3);
+    REQUIRE(shards.back()->setTarget(2));
+  }
+  std::vector<std::thread> threads;
+  for (auto &cv : shards)
+    threads.emplace_back([&cv, &root]() {
+      root->accept(cv.get());
+      cv->optimize(2);
+    });
+  for (auto &t : threads)
+    t.join();
+  // every function is defined once, not all of them in the same shard
+  std::size_t definitions = 0;
+  for (unsigned int i = 0; i < 3; i++) {
+    REQUIRE(shards[i]->compile());
+    REQUIRE(shards[i]->emit(llvm::TargetMachine::CGFT_ObjectFile));
+    std::ifstream ll("test." + std::to_string(i) + ".ll");
+    std::string ir((std::istreambuf_iterator<char>(ll)),
+                   std::istreambuf_iterator<char>());
+    std::size_t defined = 0;
+    for (auto pos = ir.find("define "); pos != std::string::npos;
+         pos = ir.find("define ", pos + 1))
+      defined++;
+    REQUIRE(defined < 3);
+    definitions += defined;
+  }
+  REQUIRE(definitions == 3);
+  system("../../llvm/install/bin/clang -w -o test test.0.o test.1.o test.2.o");
+  REQUIRE_RUN("", 41);
+}
+
+TEST_CASE("bitcode to output path") {
+  PRINT_START("bitcode to output path");
+  std::string input = "int main() {\n"
+                      "  return 7;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("test.c");
+  cv.setOutput("out.bc");
+  root->accept(&cv);
+  cv.emitBitcode();
+  std::ifstream is("out.bc", std::ifstream::binary);
+  char magic[4] = {};
+  is.read(magic, 4);
+  REQUIRE(std::string(magic, 4) == "BC\xC0\xDE");
+  system("../../llvm/install/bin/clang -w -o test out.bc");
+  REQUIRE_RUN("", 7);
+}
+
+TEST_CASE("run just in time") {
+  PRINT_START("run just in time");
+  std::string input = "int fac(int n) {\n"
+                      "  if (n < 2)\n"
+                      "    return 1;\n"
+                      "  return n * fac(n - 1);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  return fac(5) - 100;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("test.c");
+  root->accept(&cv);
+  REQUIRE(cv.run() == 20);
+}
+
+TEST_CASE("run just in time with environment and exit handlers") {
+  PRINT_START("run just in time with environment and exit handlers");
+  std::string input = "int main(int argc, char **argv, char **envp) {\n"
+                      "  if (envp[0])\n"
+                      "    return argc + 1;\n"
+                      "  return argc;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  std::remove("test.prof");
+  {
+    CodegenVisitor cv("test.c");
+    cv.setProfileGenerate("test.prof");
+    root->accept(&cv);
+    REQUIRE(cv.run() == 2);
+  }
+  // the profile is written by the handler the program registered with atexit
+  std::ifstream prof("test.prof", std::ifstream::binary | std::ifstream::ate);
+  REQUIRE(prof.tellg() == 5 * 8);
+}
+
+TEST_CASE("locals in registers") {
+  PRINT_START("locals in registers");
+  std::string input = "int main() {\n"
+                      "  int i;\n"
+                      "  int sum;\n"
+                      "  int kept;\n"
+                      "  int *p;\n"
+                      "  i = 0;\n"
+                      "  sum = 0;\n"
+                      "  kept = 1;\n"
+                      "  p = &kept;\n"
+                      "  while (i < 10) {\n"
+                      "    if (i == 5)\n"
+                      "      *p = *p + i;\n"
+                      "    else\n"
+                      "      sum = sum + i;\n"
+                      "    i = i + 1;\n"
+                      "  }\n"
+                      "  return sum + kept;\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 46);
+  // only kept has its address taken and needs a stack slot
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  std::size_t slots = 0;
+  for (auto pos = ir.find("alloca"); pos != std::string::npos;
+       pos = ir.find("alloca", pos + 1))
+    slots++;
+  REQUIRE(slots == 1);
+}
+
+TEST_CASE("short circuit without stack slots") {
+  PRINT_START("short circuit without stack slots");
+  std::string input = "int n;\n"
+                      "int bump(int v) {\n"
+                      "  n = n + 1;\n"
+                      "  return v;\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  int a;\n"
+                      "  int b;\n"
+                      "  int *p;\n"
+                      "  a = 3;\n"
+                      "  b = 0;\n"
+                      "  p = 0;\n"
+                      "  if (b && bump(1))\n"
+                      "    a = a + 1;\n"
+                      "  if (a || bump(1))\n"
+                      "    a = a + 1;\n"
+                      "  if (b || bump(1))\n"
+                      "    a = a + 10;\n"
+                      "  a = a + (b == 0 && a > 2);\n"
+                      "  a = a + (p ? *p : 2);\n"
+                      "  a = a + (b ? 1 : a - 10);\n"
+                      "  return a + n * 10 + (b || !a);\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 34);
+  // && and || and ?: merge their values in registers
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  REQUIRE(ir.find("alloca") == std::string::npos);
+  REQUIRE(ir.find("select") != std::string::npos);
+  REQUIRE(ir.find("phi i1") != std::string::npos);
+}
+
+TEST_CASE("locals unchanged on every edge of a join") {
+  PRINT_START("locals unchanged on every edge of a join");
+  // the phi of x in l2 uses the one in l1 on two edges, and both are
+  // trivial
+  std::string input = "int f(int n) {\n"
+                      "  int x;\n"
+                      "  x = 7;\n"
+                      "  if (n == 0)\n"
+                      "    goto l2;\n"
+                      "  goto l1;\n"
+                      "l2:\n"
+                      "  return x;\n"
+                      "l1:\n"
+                      "  if (n == 2)\n"
+                      "    goto l2;\n"
+                      "  if (n == 3)\n"
+                      "    goto l2;\n"
+                      "  return x + 1;\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  return f(0) + f(2) + f(3) + f(4);\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 29);
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  REQUIRE(ir.find("phi") == std::string::npos);
+}
+
+TEST_CASE("locals for the unoptimized backend") {
+  PRINT_START("locals for the unoptimized backend");
+  std::string input = "int main() {\n"
+                      "  int i;\n"
+                      "  int s;\n"
+                      "  int t;\n"
+                      "  i = 0;\n"
+                      "  s = 0;\n"
+                      "  while (i < 10) {\n"
+                      "    t = i * 2;\n"
+                      "    s = s + t;\n"
+                      "    i = i + 1;\n"
+                      "  }\n"
+                      "  return s;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  CodegenVisitor cv("test.c");
+  REQUIRE(cv.setTarget(0));
+  root->accept(&cv);
+  REQUIRE(cv.compile());
+  // only i and s, which need phis, get a stack slot
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  std::size_t slots = 0;
+  for (auto pos = ir.find("alloca"); pos != std::string::npos;
+       pos = ir.find("alloca", pos + 1))
+    slots++;
+  REQUIRE(slots == 2);
+  REQUIRE(ir.find("phi") == std::string::npos);
+  REQUIRE(cv.emit(llvm::TargetMachine::CGFT_ObjectFile));
+  system("../../llvm/install/bin/clang -w -o test test.o");
+  REQUIRE_RUN("", 90);
+}
+
+TEST_CASE("pooled strings") {
+  PRINT_START("pooled strings");
+  std::string input = "int main() {\n"
+                      "  char *a;\n"
+                      "  char *b;\n"
+                      "  char *c;\n"
+                      "  a = \"hello world\";\n"
+                      "  b = \"world\";\n"
+                      "  c = \"hello world\";\n"
+                      "  return (a == c) + (a + 6 == b) * 2 +\n"
+                      "         (*b == 'w') * 4;\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 7);
+  // all three literals share one constant
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  auto first = ir.find("private unnamed_addr constant");
+  REQUIRE(first != std::string::npos);
+  REQUIRE(ir.find("private unnamed_addr constant", first + 1) ==
+          std::string::npos);
+}
+
+TEST_CASE("strings pooled by their value") {
+  PRINT_START("strings pooled by their value");
+  std::string input = "int main() {\n"
+                      "  char *a;\n"
+                      "  char *b;\n"
+                      "  a = \"a?b\";\n"
+                      "  b = \"a\\?b\";\n"
+                      "  return a == b;\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 1);
+}
+
+TEST_CASE("jumps without dead blocks") {
+  PRINT_START("jumps without dead blocks");
+  std::string input = "int f(int n) {\n"
+                      "  int s;\n"
+                      "  s = 0;\n"
+                      "  if (n == 0)\n"
+                      "    goto done;\n"
+                      "  if (n == 1)\n"
+                      "    goto one;\n"
+                      "again:\n"
+                      "  s = s + n;\n"
+                      "  n = n - 1;\n"
+                      "  if (0 < n)\n"
+                      "    goto again;\n"
+                      "  goto done;\n"
+                      "  s = 1000;\n"
+                      "one:\n"
+                      "  s = s + 100;\n"
+                      "done:\n"
+                      "  return s;\n"
+                      "  s = 5;\n"
+                      "}\n"
+                      "int g(int n) {\n"
+                      "  while (1) {\n"
+                      "    if (n < 3)\n"
+                      "      return n;\n"
+                      "    else\n"
+                      "      return 7;\n"
+                      "    n = n + 1;\n"
+                      "  }\n"
+                      "  return 9;\n"
+                      "}\n"
+                      "int h(int n) {\n"
+                      "  while (n < 10) {\n"
+                      "    n = n + 1;\n"
+                      "    break;\n"
+                      "    n = 100;\n"
+                      "  }\n"
+                      "  if (n == 1)\n"
+                      "    return 4;\n"
+                      "  else\n"
+                      "    return n;\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  return f(0) + f(1) + f(4) * 2 + g(1) * 10 + g(5) +\n"
+                      "         h(0);\n"
+                      "}\n";
+  CLANG;
+  REQUIRE_BUILD;
+  REQUIRE_RUN("", 141);
+  // code behind jumps is left out, every block has a predecessor
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  REQUIRE(ir.find("No predecessors") == std::string::npos);
+  REQUIRE(ir.find("1000") == std::string::npos);
+}
+
+TEST_CASE("profile guided optimization") {
+  PRINT_START("profile guided optimization");
+  std::string input = "int f(int n) {\n"
+                      "  if (n < 3)\n"
+                      "    return 1;\n"
+                      "  return 2;\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  int i;\n"
+                      "  int s;\n"
+                      "  i = 0;\n"
+                      "  s = 0;\n"
+                      "  while (i < 10) {\n"
+                      "    s = s + f(i);\n"
+                      "    i = i + 1;\n"
+                      "  }\n"
+                      "  return s;\n"
+                      "}\n";
+  FastParser fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  SemanticVisitor sv;
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+  std::remove("test.prof");
+  {
+    CodegenVisitor cv("test.c");
+    cv.setProfileGenerate("test.prof");
+    root->accept(&cv);
+    cv.compile();
+    system("../../llvm/install/bin/clang -w -o test test.ll");
+    REQUIRE_RUN("", 17);
+  }
+  // magic number, checksum and a counter for each function and two for
+  // each if and while
+  std::ifstream prof("test.prof", std::ifstream::binary | std::ifstream::ate);
+  REQUIRE(prof.tellg() == 8 * 8);
+  CodegenVisitor cv("test.c");
+  REQUIRE_FALSE(cv.setProfileUse("missing.prof"));
+  REQUIRE(cv.setProfileUse("test.prof"));
+  root->accept(&cv);
+  cv.compile();
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  REQUIRE(ir.find("!{!\"function_entry_count\", i64 10}") != std::string::npos);
+  REQUIRE(ir.find("!{!\"branch_weights\", i32 3, i32 7}") != std::string::npos);
+  REQUIRE(ir.find("!{!\"branch_weights\", i32 10, i32 1}") !=
+          std::string::npos);
+  REQUIRE(ir.find("ProfileSummary") != std::string::npos);
+  system("../../llvm/install/bin/clang -w -o test test.ll");
+  REQUIRE_RUN("", 17);
+}
+
+TEST_CASE("function attribute inference") {
+  PRINT_START("function attribute inference");
+  std::string input = "int g;\n"
+                      "int puts(char *s);\n"
+                      "int sq(int x) { return x * x; }\n"
+                      "int get() { return g; }\n"
+                      "int sum(int *p, int n) {\n"
+                      "  int s;\n"
+                      "  s = 0;\n"
+                      "  while (n != 0) {\n"
+                      "    n = n - 1;\n"
+                      "    s = s + p[n];\n"
+                      "  }\n"
+                      "  return s;\n"
+                      "}\n"
+                      "int moved(int *p) {\n"
+                      "  p = &g;\n"
+                      "  *p = sq(2);\n"
+                      "  return 0;\n"
+                      "}\n"
+                      "int even(int n);\n"
+                      "int odd(int n) {\n"
+                      "  if (n == 0)\n"
+                      "    return 0;\n"
+                      "  return even(n - 1);\n"
+                      "}\n"
+                      "int even(int n) {\n"
+                      "  if (n == 0)\n"
+                      "    return 1;\n"
+                      "  return odd(n - 1);\n"
+                      "}\n"
+                      "int main() {\n"
+                      "  puts(\"\");\n"
+                      "  moved(&g);\n"
+                      "  return sq(2) + get() + sum(&g, 1) + even(4);\n"
+                      "}\n";
+  REQUIRE_BUILD;
+  std::ifstream ll("test.ll");
+  std::string ir((std::istreambuf_iterator<char>(ll)),
+                 std::istreambuf_iterator<char>());
+  auto attributes = [&ir](const std::string &signature) {
+    auto define = ir.find("define " + signature + " #");
+    REQUIRE(define != std::string::npos);
+    auto group = ir.substr(define + signature.size() + 9);
+    group = group.substr(0, group.find(' '));
+    auto line = ir.find("attributes #" + group + " = ");
+    REQUIRE(line != std::string::npos);
+    return ir.substr(line, ir.find('\n', line) - line);
+  };
+  REQUIRE(attributes("i32 @sq(i32 %x)").find("norecurse nounwind readnone") !=
+          std::string::npos);
+  REQUIRE(attributes("i32 @get()").find("norecurse nounwind readonly") !=
+          std::string::npos);
+  REQUIRE(attributes("i32 @sum(i32* noalias %p, i32 %n)")
+              .find("argmemonly norecurse nounwind readonly") !=
+          std::string::npos);
+  // p doesn't point to the argument anymore
+  REQUIRE(attributes("i32 @moved(i32* %p)").find("{ norecurse nounwind }") !=
+          std::string::npos);
+  REQUIRE(attributes("i32 @odd(i32 %n)").find("{ nounwind readnone }") !=
+          std::string::npos);
+  // puts could call main again
+  REQUIRE(attributes("i32 @main()").find("{ nounwind }") != std::string::npos);
+  REQUIRE(ir.find("declare i32 @puts(i8*)\n") != std::string::npos);
+  REQUIRE_RUN("", 13);
+}
 } // namespace ccc
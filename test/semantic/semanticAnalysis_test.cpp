@@ -35,6 +35,43 @@ TEST_CASE("undeclared label") {
           SEMANTIC_ERROR(2, 8, "Use of undeclared label 'foo'"));
 }
 
+TEST_CASE("labels are local to their function") {
+  std::string input = "int f() {\n"
+                      "foo:\n"
+                      "  return 0;\n"
+                      "}\n"
+                      "int g() {\n"
+                      "foo:\n"
+                      "  return 1;\n"
+                      "}\n";
+
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto sv = SemanticVisitor();
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+}
+
+TEST_CASE("goto a label of another function") {
+  std::string input = "int f() {\n"
+                      "  goto foo;\n"
+                      "}\n"
+                      "int g() {\n"
+                      "foo:\n"
+                      "  return 1;\n"
+                      "}\n";
+
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto sv = SemanticVisitor();
+  root->accept(&sv);
+  REQUIRE_FAILURE(sv);
+  REQUIRE(sv.getError() ==
+          SEMANTIC_ERROR(2, 8, "Use of undeclared label 'foo'"));
+}
+
 TEST_CASE("double goto") {
   std::string input = "int main() {\n"
                       "   goto bar;\n"
@@ -620,4 +657,73 @@ TEST_CASE("function no name 3") {
                        "Expected identifier, parameter list or parenthesized "
                        "declarator found \"int\""));
 }
+
+TEST_CASE("shadowing in nested scopes") {
+  std::string input = "int x;\n"
+                      "int f(int y) {\n"
+                      "  char *x;\n"
+                      "  {\n"
+                      "    int y;\n"
+                      "    y = 1;\n"
+                      "  }\n"
+                      "  x = \"a\";\n"
+                      "  return y;\n"
+                      "}\n"
+                      "int g() { return x; }\n";
+
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto sv = SemanticVisitor();
+  root->accept(&sv);
+  REQUIRE_SUCCESS(sv);
+}
+
+TEST_CASE("parameter redefined in body") {
+  std::string input = "int f(int y) {\n"
+                      "  int y;\n"
+                      "  return y;\n"
+                      "}\n";
+
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto sv = SemanticVisitor();
+  root->accept(&sv);
+  REQUIRE_FAILURE(sv);
+  REQUIRE(sv.getError() == SEMANTIC_ERROR(2, 7, "Redefinition of 'y'"));
+}
+
+TEST_CASE("identifier out of scope") {
+  std::string input = "int f() {\n"
+                      "  {\n"
+                      "    int y;\n"
+                      "  }\n"
+                      "  return y;\n"
+                      "}\n";
+
+  auto fp = FastParser(input);
+  auto root = fp.parse();
+  REQUIRE_SUCCESS(fp);
+  auto sv = SemanticVisitor();
+  root->accept(&sv);
+  REQUIRE_FAILURE(sv);
+  REQUIRE(sv.getError() ==
+          SEMANTIC_ERROR(5, 10, "Use of undeclared identifier 'y'"));
+}
+
+TEST_CASE("diagnostics are formatted on demand") {
+  TypeContext types;
+  auto p = types.getPointer(types.getScalar(RawTypeValue::CHAR));
+  DiagnosticsEngine diagnostics;
+  REQUIRE(diagnostics.empty());
+  REQUIRE_FALSE(diagnostics.error(Location(2, 4), "Can't assign %0 to %1", p,
+                                  types.getScalar(RawTypeValue::INT)));
+  REQUIRE_FALSE(diagnostics.error(Location(3, 0), "Redefinition of '%0'",
+                                  std::string("x")));
+  REQUIRE(diagnostics.size() == 2);
+  REQUIRE(diagnostics.format(0) ==
+          SEMANTIC_ERROR(2, 5, "Can't assign " + p->print() + " to int"));
+  REQUIRE(diagnostics.format(1) == SEMANTIC_ERROR(3, 1, "Redefinition of 'x'"));
+}
 } // namespace ccc